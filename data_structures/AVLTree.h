@@ -1,453 +1,1064 @@
 #pragma once
 
-#include <iostream>
-#include <vector>
-#include <stdexcept>
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <iterator>
-#include <string>
-#include <memory>
-#include <map>
-
-// Enum for rotation types
-enum class RotationType {
-    LL,
-    RR,
-    LR,
-    RL
+#include <ostream>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "FrozenAVLTree.h"
+
+// Node of AVLTree. The children and the parent are 32-bit indices into the node arena of the tree, and the
+// balance factor (right height - left height, -1..1) is packed into the top two bits of the parent index.
+// size counts the nodes of the subtree for select and rank, and a node of an int set takes 20 bytes instead of
+// the 40 of a pointer-based node
+template<typename Key, typename Value>
+struct AVLNode {
+    Key key;
+    Value value;
+    std::uint32_t links[2];
+    std::uint32_t parent_balance;
+    std::uint32_t size;
 };
 
-// Convert enum to string for comparison and output
-std::string rotationTypeToString(RotationType type) {
-    switch (type) {
-    case RotationType::LL: return "LL";
-    case RotationType::RR: return "RR";
-    case RotationType::LR: return "LR";
-    case RotationType::RL: return "RL";
-    default: return "UNKNOWN";
-    }
-}
+template<typename Key>
+struct AVLNode<Key, void> {
+    Key key;
+    std::uint32_t links[2];
+    std::uint32_t parent_balance;
+    std::uint32_t size;
+};
 
-class AVLNode {
+// Ordered set (Value = void) or map with unique keys. All nodes live in one arena vector: erased nodes are
+// chained into a free list that later inserts reuse, and clear or the destructor release the arena at once
+// instead of visiting every node. The arena may move when it grows, so node pointers returned by search and by
+// dereferencing an iterator are valid only until the next insert, while an iterator stays valid until its node
+// is erased.
+// With a transparent Compare such as std::less<>, search and contains accept any type comparable with Key
+template<typename Key, typename Value = void, typename Compare = std::less<Key>>
+class AVLTree {
 public:
-    int value;
-    AVLNode* parent;
-    AVLNode* left;
-    AVLNode* right;
-    int height;
+    using node_type = AVLNode<Key, Value>;
 
-    AVLNode(int value, AVLNode* parent = nullptr)
-        : value(value), parent(parent), left(nullptr), right(nullptr), height(1) {
+    // index of a missing child or parent; also the maximum number of nodes
+    static constexpr std::uint32_t nil = (std::uint32_t(1) << 30) - 1;
+
+private:
+    static constexpr int balance_shift = 30;
+
+    std::vector<node_type> nodes;
+    std::uint32_t root_index = nil;
+    std::uint32_t free_nodes = nil;
+    Compare compare;
+
+    std::uint32_t parent_of(std::uint32_t index) const {
+        return nodes[index].parent_balance & nil;
     }
 
-    void add_edges(std::vector<std::pair<int, int>>& edges) {
-        if (left != nullptr) {
-            edges.push_back(std::make_pair(value, left->value));
-            left->add_edges(edges);
-        }
-        if (right != nullptr) {
-            edges.push_back(std::make_pair(value, right->value));
-            right->add_edges(edges);
+    int balance_of(std::uint32_t index) const {
+        return static_cast<int>(nodes[index].parent_balance >> balance_shift) - 1;
+    }
+
+    void set_parent(std::uint32_t index, std::uint32_t parent) {
+        nodes[index].parent_balance = (nodes[index].parent_balance & ~nil) | parent;
+    }
+
+    void set_balance(std::uint32_t index, int balance) {
+        nodes[index].parent_balance = (nodes[index].parent_balance & nil) | (static_cast<std::uint32_t>(balance + 1) << balance_shift);
+    }
+
+    std::uint32_t subtree_size(std::uint32_t index) const {
+        return index == nil ? 0 : nodes[index].size;
+    }
+
+    // adds difference to the sizes of index and all its ancestors; unlike the balance factors they change up to the root
+    void add_to_sizes(std::uint32_t index, std::uint32_t difference) {
+        for (; index != nil; index = parent_of(index)) {
+            nodes[index].size += difference;
         }
     }
 
-    int left_height() {
-        if (left == nullptr) {
-            return 0;
+    node_type* to_pointer(std::uint32_t index) {
+        return index == nil ? nullptr : &nodes[index];
+    }
+
+    std::uint32_t to_index(const node_type* node) const {
+        return static_cast<std::uint32_t>(node - nodes.data());
+    }
+
+    template<typename... Args>
+    std::uint32_t allocate_node(Key&& key, std::uint32_t parent, Args&&... value) {
+        std::uint32_t index;
+        if (free_nodes != nil) {
+            index = free_nodes;
+            free_nodes = nodes[index].links[0];
+            nodes[index].key = std::move(key);
+            if constexpr (!std::is_void<Value>::value) {
+                nodes[index].value = Value(std::forward<Args>(value)...);
+            }
         }
         else {
-            return left->height;
+            if (nodes.size() == nil) {
+                throw std::length_error("The tree cannot hold more nodes");
+            }
+            if constexpr (std::is_void<Value>::value) {
+                nodes.push_back(node_type{ std::move(key), { nil, nil }, 0, 1 });
+            }
+            else {
+                nodes.push_back(node_type{ std::move(key), Value(std::forward<Args>(value)...), { nil, nil }, 0, 1 });
+            }
+            index = static_cast<std::uint32_t>(nodes.size() - 1);
         }
+
+        nodes[index].links[0] = nodes[index].links[1] = nil;
+        nodes[index].parent_balance = parent;
+        nodes[index].size = 1;
+        set_balance(index, 0);
+        return index;
     }
 
-    int right_height() {
-        if (right == nullptr) {
-            return 0;
+    // free slots are the ones with a subtree size of 0
+    void release_node(std::uint32_t index) {
+        // the moved-from key and value keep no resources while the node waits for reuse
+        static_cast<void>(Key(std::move(nodes[index].key)));
+        if constexpr (!std::is_void<Value>::value) {
+            static_cast<void>(Value(std::move(nodes[index].value)));
+        }
+        nodes[index].size = 0;
+        nodes[index].links[0] = free_nodes;
+        free_nodes = index;
+    }
+
+    // puts replacement where child was under parent, or at the root. A detached subtree, as used by join and
+    // split, has no parent either but leaves root_index alone
+    void replace_child(std::uint32_t parent, std::uint32_t child, std::uint32_t replacement) {
+        if (parent == nil) {
+            if (root_index == child) {
+                root_index = replacement;
+            }
         }
         else {
-            return right->height;
+            nodes[parent].links[nodes[parent].links[1] == child] = replacement;
+        }
+        if (replacement != nil) {
+            set_parent(replacement, parent);
         }
     }
 
-    void update_height() {
-        height = std::max(left_height(), right_height()) + 1;
+    // the child of node on the side opposite to direction (0 left, 1 right) takes its place; returns that child
+    std::uint32_t rotate(std::uint32_t node, int direction) {
+        auto child = nodes[node].links[1 - direction];
+        auto inner = nodes[child].links[direction];
 
-        if (parent) {
-            parent->update_height();
+        replace_child(parent_of(node), node, child);
+        nodes[node].links[1 - direction] = inner;
+        if (inner != nil) {
+            set_parent(inner, node);
         }
-    }
+        nodes[child].links[direction] = node;
+        set_parent(node, child);
 
-    int balance_factor() {
-        return left_height() - right_height();
+        nodes[child].size = nodes[node].size;
+        nodes[node].size = subtree_size(nodes[node].links[0]) + subtree_size(nodes[node].links[1]) + 1;
+        return child;
     }
 
-    void set_left_child(AVLNode* node) {
-        left = node;
-        if (node != nullptr) {
-            node->parent = this;
+    // node has a balance factor of 2 * heavy, which does not fit in the node; returns the new root of the subtree
+    std::uint32_t restructure(std::uint32_t node, int heavy) {
+        auto direction = heavy > 0 ? 0 : 1;
+        auto child = nodes[node].links[1 - direction];
+        auto child_balance = balance_of(child);
+
+        if (child_balance == -heavy) {
+            auto grandchild = nodes[child].links[direction];
+            auto grandchild_balance = balance_of(grandchild);
+            rotate(child, 1 - direction);
+            rotate(node, direction);
+
+            set_balance(node, grandchild_balance == heavy ? -heavy : 0);
+            set_balance(child, grandchild_balance == -heavy ? heavy : 0);
+            set_balance(grandchild, 0);
+            return grandchild;
         }
+
+        rotate(node, direction);
+        // a balanced child only occurs after an erase; the subtree then keeps its height
+        set_balance(node, child_balance == 0 ? heavy : 0);
+        set_balance(child, child_balance == 0 ? -heavy : 0);
+        return child;
     }
 
-    void set_right_child(AVLNode* node) {
-        right = node;
-        if (node != nullptr) {
-            node->parent = this;
+    // first node whose key is not less than key, or with upper greater than key. Descends to a leaf with one
+    // comparison per level and the child picked by index; random lookups mispredict about half of the branches
+    // of a three-way descent
+    template<bool upper, typename K>
+    std::uint32_t bound_index(const K& key) const {
+        auto current = root_index;
+        auto candidate = nil;
+        while (current != nil) {
+            const auto& node = nodes[current];
+            bool right = upper ? !compare(key, node.key) : compare(node.key, key);
+            candidate = right ? candidate : current;
+            current = node.links[right];
         }
+        return candidate;
     }
 
-    bool is_left() {
-        return (parent != nullptr) && (parent->left == this);
+    template<typename K>
+    std::uint32_t find_index(const K& key) const {
+        auto candidate = bound_index<false>(key);
+        return candidate != nil && !compare(key, nodes[candidate].key) ? candidate : nil;
     }
 
-    AVLNode* leftmost() {
-        if (left == nullptr) {
-            return this;
-        }
-        else {
-            return left->leftmost();
+    // number of keys less than key
+    template<typename K>
+    size_t rank_of(const K& key) const {
+        size_t rank = 0;
+        auto current = root_index;
+        while (current != nil) {
+            const auto& node = nodes[current];
+            bool right = compare(node.key, key);
+            rank += right ? subtree_size(node.links[0]) + 1 : 0;
+            current = node.links[right];
         }
+        return rank;
     }
 
-    AVLNode* rightmost() {
-        if (right == nullptr) {
-            return this;
+    template<typename K>
+    size_t count_between(const K& low, const K& high) const {
+        return compare(low, high) ? rank_of(high) - rank_of(low) : 0;
+    }
+
+    // exchanges the places of target and its in-order predecessor, which has no right child
+    void swap_with_predecessor(std::uint32_t target) {
+        auto predecessor = nodes[target].links[0];
+        while (nodes[predecessor].links[1] != nil) {
+            predecessor = nodes[predecessor].links[1];
+        }
+
+        auto target_left = nodes[target].links[0];
+        auto target_right = nodes[target].links[1];
+        auto target_balance = balance_of(target);
+        auto predecessor_parent = parent_of(predecessor);
+        auto predecessor_left = nodes[predecessor].links[0];
+        auto predecessor_balance = balance_of(predecessor);
+
+        replace_child(parent_of(target), target, predecessor);
+        nodes[predecessor].links[1] = target_right;
+        set_parent(target_right, predecessor);
+        if (predecessor_parent == target) {
+            nodes[predecessor].links[0] = target;
+            set_parent(target, predecessor);
         }
         else {
-            return right->rightmost();
+            nodes[predecessor].links[0] = target_left;
+            set_parent(target_left, predecessor);
+            nodes[predecessor_parent].links[1] = target;
+            set_parent(target, predecessor_parent);
         }
+        set_balance(predecessor, target_balance);
+
+        nodes[target].links[0] = predecessor_left;
+        if (predecessor_left != nil) {
+            set_parent(predecessor_left, target);
+        }
+        nodes[target].links[1] = nil;
+        set_balance(target, predecessor_balance);
+        std::swap(nodes[target].size, nodes[predecessor].size);
     }
-};
 
-class AVLTree {
-private:
-    std::vector<AVLNode*> array_representation;
-    size_t current;
+    void erase_index(std::uint32_t target) {
+        if (nodes[target].links[0] != nil && nodes[target].links[1] != nil) {
+            swap_with_predecessor(target);
+        }
 
-public:
-    AVLNode* root;
+        auto child = nodes[target].links[0] != nil ? nodes[target].links[0] : nodes[target].links[1];
+        auto parent = parent_of(target);
+        auto side = parent != nil && nodes[parent].links[1] == target;
+        replace_child(parent, target, child);
+        release_node(target);
 
-    AVLTree() : root(nullptr), current(0) {}
+        // the subtree on side of parent got one level shorter; stop once a subtree keeps its height,
+        // counting down the sizes of the remaining ancestors
+        while (parent != nil) {
+            nodes[parent].size--;
+            auto balance = balance_of(parent) + (side ? -1 : 1);
+            auto grandparent = parent_of(parent);
+            if (balance == 1 || balance == -1) {
+                set_balance(parent, balance);
+                add_to_sizes(grandparent, static_cast<std::uint32_t>(-1));
+                return;
+            }
 
-    std::vector<AVLNode*> traverse_inorder(AVLNode* node) {
-        if (node == nullptr) {
-            return std::vector<AVLNode*>();
+            auto parent_side = grandparent != nil && nodes[grandparent].links[1] == parent;
+            if (balance == 0) {
+                set_balance(parent, 0);
+            }
+            else {
+                auto heavy = balance > 0 ? 1 : -1;
+                auto sibling_balance = balance_of(nodes[parent].links[heavy > 0 ? 1 : 0]);
+                restructure(parent, heavy);
+                if (sibling_balance == 0) {
+                    add_to_sizes(grandparent, static_cast<std::uint32_t>(-1));
+                    return;
+                }
+            }
+            parent = grandparent;
+            side = parent_side;
         }
+    }
 
-        std::vector<AVLNode*> array_repr = traverse_inorder(node->left);
-        array_repr.push_back(node);
-        std::vector<AVLNode*> right_traversal = traverse_inorder(node->right);
-        array_repr.insert(array_repr.end(), right_traversal.begin(), right_traversal.end());
-
-        return array_repr;
+    bool erase_found(std::uint32_t target) {
+        if (target == nil) {
+            return false;
+        }
+        erase_index(target);
+        return true;
     }
 
-    // Iterator functionality
-    class iterator {
-    private:
-        std::vector<AVLNode*> nodes;
-        size_t index;
+    // last node of the subtree of index in direction side (0 leftmost, 1 rightmost)
+    std::uint32_t extreme(std::uint32_t index, int side) const {
+        if (index != nil) {
+            while (nodes[index].links[side] != nil) {
+                index = nodes[index].links[side];
+            }
+        }
+        return index;
+    }
 
-    public:
-        iterator(const std::vector<AVLNode*>& nodes, size_t index) : nodes(nodes), index(index) {}
+    // in-order neighbour of index in direction side (1 next, 0 previous); amortized O(1) over a whole traversal
+    std::uint32_t step(std::uint32_t index, int side) const {
+        if (nodes[index].links[side] != nil) {
+            return extreme(nodes[index].links[side], 1 - side);
+        }
+        auto parent = parent_of(index);
+        while (parent != nil && nodes[parent].links[side] == index) {
+            index = parent;
+            parent = parent_of(parent);
+        }
+        return parent;
+    }
 
-        AVLNode* operator*() { return nodes[index]; }
-        iterator& operator++() { ++index; return *this; }
-        bool operator!=(const iterator& other) const { return index != other.index; }
-        bool operator==(const iterator& other) const { return index == other.index; }
-    };
+    // the subtree of child got one level taller; stop once a subtree keeps its height.
+    // Returns true if the topmost subtree grew as well
+    bool retrace_growth(std::uint32_t child) {
+        for (auto parent = parent_of(child); parent != nil; child = parent, parent = parent_of(parent)) {
+            auto balance = balance_of(parent) + (nodes[parent].links[1] == child ? 1 : -1);
+            if (balance == 0) {
+                set_balance(parent, 0);
+                return false;
+            }
+            if (balance == 1 || balance == -1) {
+                set_balance(parent, balance);
+                continue;
+            }
 
-    iterator begin() {
-        array_representation = traverse_inorder(root);
-        return iterator(array_representation, 0);
+            // a balanced child only occurs after join_at, and then the rotated subtree is still one level taller
+            auto child_balance = balance_of(child);
+            parent = restructure(parent, balance > 0 ? 1 : -1);
+            if (child_balance != 0) {
+                return false;
+            }
+        }
+        return true;
     }
 
-    iterator end() {
-        return iterator(array_representation, array_representation.size());
+    // walks the taller side down in O(height); split and join get the heights of subtrees from child_of instead
+    std::uint32_t height_of(std::uint32_t index) const {
+        std::uint32_t height = 0;
+        for (; index != nil; index = nodes[index].links[balance_of(index) > 0 ? 1 : 0]) {
+            height++;
+        }
+        return height;
     }
 
-    AVLNode* right_rotation(AVLNode* node) {
-        AVLNode* x = node;
-        AVLNode* y = node->left;
-        AVLNode* t1 = y->left;
-        AVLNode* t2 = y->right;
-        AVLNode* t3 = x->right;
+    // height of the trees build_balanced makes from count nodes
+    static std::uint32_t height_of_count(std::uint32_t count) {
+        std::uint32_t height = 0;
+        for (; count != 0; count >>= 1) {
+            height++;
+        }
+        return height;
+    }
 
-        y->set_right_child(x);
-        y->set_left_child(t1);
-        x->set_left_child(t2);
-        x->set_right_child(t3);
+    // makes left and right the children of node; the parent of node is left to the caller
+    void link(std::uint32_t node, std::uint32_t left, std::uint32_t right, int balance) {
+        nodes[node].links[0] = left;
+        nodes[node].links[1] = right;
+        for (auto child : { left, right }) {
+            if (child != nil) {
+                set_parent(child, node);
+            }
+        }
+        set_balance(node, balance);
+        nodes[node].size = subtree_size(left) + subtree_size(right) + 1;
+    }
 
-        return y;
+    void detach(std::uint32_t index) {
+        if (index != nil) {
+            set_parent(index, nil);
+        }
     }
 
-    AVLNode* left_rotation(AVLNode* node) {
-        AVLNode* x = node;
-        AVLNode* y = node->right;
-        AVLNode* t1 = x->left;
-        AVLNode* t2 = y->left;
-        AVLNode* t3 = y->right;
+    // a detached subtree with its height, which split and join pass along instead of measuring it again
+    struct subtree {
+        std::uint32_t root;
+        std::uint32_t height;
+    };
 
-        y->set_left_child(x);
-        x->set_left_child(t1);
-        x->set_right_child(t2);
-        y->set_right_child(t3);
+    // the child subtree of parent on side; its height follows from the balance factor of parent
+    subtree child_of(subtree parent, int side) const {
+        auto balance = balance_of(parent.root);
+        auto shorter = side == 1 ? balance < 0 : balance > 0;
+        return { nodes[parent.root].links[side], parent.height - (shorter ? 2 : 1) };
+    }
 
-        return y;
+    // links nodes[first, last), which are in key order, into a perfectly balanced subtree in O(n)
+    std::uint32_t build_balanced(std::uint32_t first, std::uint32_t last) {
+        if (first == last) {
+            return nil;
+        }
+        auto middle = first + (last - first) / 2;
+        auto left = build_balanced(first, middle);
+        auto right = build_balanced(middle + 1, last);
+        link(middle, left, right, static_cast<int>(height_of_count(last - middle - 1)) - static_cast<int>(height_of_count(middle - first)));
+        return middle;
     }
 
-    AVLNode* left_right_rotation(AVLNode* node) {
-        AVLNode* x = node;
-        AVLNode* y = left_rotation(node->left);
-        x->set_left_child(y);
+    // Joins the detached subtrees left and right with the detached node middle between them in key order, in
+    // O(difference of their heights + 1): middle replaces the node on the inner spine of the taller subtree that is
+    // at most one level taller than the other, and the path above is rebalanced as after an insert.
+    // Returns the joined subtree, whose root has no parent
+    subtree join_at(subtree left, std::uint32_t middle, subtree right) {
+        if (left.height <= right.height + 1 && right.height <= left.height + 1) {
+            link(middle, left.root, right.root, static_cast<int>(right.height) - static_cast<int>(left.height));
+            detach(middle);
+            return { middle, std::max(left.height, right.height) + 1 };
+        }
 
-        return right_rotation(x);
-    }
+        // side is the inner spine of the taller subtree: the right one of left or the left one of right
+        auto side = left.height > right.height ? 1 : 0;
+        auto shorter = side == 1 ? right : left;
+        auto taller = side == 1 ? left : right;
+        auto added = subtree_size(shorter.root) + 1;
+        auto parent = nil;
+        auto current = taller;
+        while (current.height > shorter.height + 1) {
+            nodes[current.root].size += added;
+            parent = current.root;
+            current = child_of(current, side);
+        }
 
-    AVLNode* right_left_rotation(AVLNode* node) {
-        AVLNode* x = node;
-        AVLNode* y = right_rotation(node->right);
-        x->set_right_child(y);
+        // middle ends up one level taller than the subtree it replaces
+        auto difference = static_cast<int>(current.height) - static_cast<int>(shorter.height);
+        if (side == 1) {
+            link(middle, current.root, shorter.root, -difference);
+        }
+        else {
+            link(middle, shorter.root, current.root, difference);
+        }
+        nodes[parent].links[side] = middle;
+        set_parent(middle, parent);
+        auto grew = retrace_growth(middle);
 
-        return left_rotation(x);
+        // only a rotation at the root of taller replaces it, and then the new root is its parent
+        auto root = parent_of(taller.root) == nil ? taller.root : parent_of(taller.root);
+        return { root, taller.height + (grew ? 1 : 0) };
     }
 
-    void rotate(AVLNode* node, RotationType type) {
-        AVLNode* parent = node->parent;
-        bool is_left = node->is_left();
-
-        AVLNode* new_node = nullptr;
+    struct split_parts {
+        subtree less;
+        std::uint32_t found;
+        subtree greater;
+    };
 
-        if (type == RotationType::LL) {
-            new_node = left_rotation(node);
-        }
-        else if (type == RotationType::RR) {
-            new_node = right_rotation(node);
+    // splits the detached subtree root into detached subtrees of the keys less and greater than key, and the
+    // detached node with key if there is one. O(log n): each join costs the difference of the heights it joins,
+    // and along the path these differences add up to the height of root
+    template<typename K>
+    split_parts split_at(subtree root, const K& key) {
+        if (root.root == nil) {
+            return { { nil, 0 }, nil, { nil, 0 } };
         }
-        else if (type == RotationType::LR) {
-            new_node = left_right_rotation(node);
+        auto left = child_of(root, 0);
+        auto right = child_of(root, 1);
+        detach(left.root);
+        detach(right.root);
+
+        if (compare(key, nodes[root.root].key)) {
+            auto parts = split_at(left, key);
+            return { parts.less, parts.found, join_at(parts.greater, root.root, right) };
         }
-        else if (type == RotationType::RL) {
-            new_node = right_left_rotation(node);
+        if (compare(nodes[root.root].key, key)) {
+            auto parts = split_at(right, key);
+            return { join_at(left, root.root, parts.less), parts.found, parts.greater };
         }
-        else {
-            throw std::runtime_error("Unknown rotation type " + rotationTypeToString(type));
+        return { left, root.root, right };
+    }
+
+    // detaches the last node of the detached subtree root in O(log n); returns the rest and that node
+    std::pair<subtree, std::uint32_t> split_last(subtree root) {
+        auto left = child_of(root, 0);
+        auto right = child_of(root, 1);
+        detach(left.root);
+        detach(right.root);
+        if (right.root == nil) {
+            return { left, root.root };
         }
+        auto parts = split_last(right);
+        return { join_at(left, root.root, parts.first), parts.second };
+    }
 
-        if (parent != nullptr) {
-            if (is_left) {
-                parent->set_left_child(new_node);
-            }
-            else {
-                parent->set_right_child(new_node);
-            }
+    // joins detached subtrees whose keys all precede those of right in O(log n)
+    subtree concatenate(subtree left, subtree right) {
+        if (left.root == nil) {
+            return right;
         }
-        else {
-            root = new_node;
-            new_node->parent = nullptr;
+        if (right.root == nil) {
+            return left;
         }
+        auto parts = split_last(left);
+        return join_at(parts.first, parts.second, right);
+    }
+
+    // a dropped node becomes a free slot when collect_free_nodes runs after the bulk operation
+    void drop(std::uint32_t index) {
+        nodes[index].size = 0;
+    }
 
-        new_node->left->update_height();
-        new_node->right->update_height();
-        new_node->update_height();
+    void drop_subtree(std::uint32_t index) {
+        if (index != nil) {
+            drop_subtree(nodes[index].links[0]);
+            drop_subtree(nodes[index].links[1]);
+            drop(index);
+        }
     }
 
-    void restructure(AVLNode* node, bool verbose = true) {
-        AVLNode* parent = node->parent;
-        if (node->balance_factor() >= -1 && node->balance_factor() <= 1) {
-            if (parent != nullptr) {
-                restructure(parent);
+    // rebuilds the free list from the slots with a size of 0
+    void collect_free_nodes() {
+        free_nodes = nil;
+        for (auto index = static_cast<std::uint32_t>(nodes.size()); index-- > 0;) {
+            if (nodes[index].size == 0) {
+                release_node(index);
             }
-            return;
         }
+    }
 
-        if (node->balance_factor() == -2) {
-            if (node->right->right_height() > node->right->left_height()) {
-                if (verbose) {
-                    std::cout << "left" << std::endl;
-                }
-                rotate(node, RotationType::LL);
+    enum class set_operation {
+        union_of,
+        intersection_of,
+        difference_of
+    };
+
+    // below this many nodes a bulk operation does not start another thread
+    static constexpr size_t parallel_grain = size_t(1) << 14;
+
+    // join-based set operation on the detached subtrees first and second of this arena: second is split by the
+    // key of the root of first, and the two halves are combined independently, the left one on another thread
+    // while threads and the subtrees are large enough. The halves touch disjoint nodes, and no node is allocated.
+    // Of two equal keys the node of first is kept
+    template<set_operation operation>
+    subtree combine(subtree first, subtree second, size_t threads) {
+        if (first.root == nil || second.root == nil) {
+            if constexpr (operation == set_operation::union_of) {
+                return first.root == nil ? second : first;
             }
-            else {
-                if (verbose) {
-                    std::cout << "right-left" << std::endl;
-                }
-                rotate(node, RotationType::RL);
+            if (operation == set_operation::difference_of && second.root == nil) {
+                return first;
             }
+            drop_subtree(first.root);
+            drop_subtree(second.root);
+            return { nil, 0 };
+        }
+
+        auto parts = split_at(second, nodes[first.root].key);
+        auto left = child_of(first, 0);
+        auto right = child_of(first, 1);
+        detach(left.root);
+        detach(right.root);
+
+        subtree combined_left, combined_right;
+        if (threads > 1 && subtree_size(first.root) + subtree_size(parts.less.root) + subtree_size(parts.greater.root) >= parallel_grain) {
+            std::thread worker([&]() { combined_left = combine<operation>(left, parts.less, threads / 2); });
+            combined_right = combine<operation>(right, parts.greater, threads - threads / 2);
+            worker.join();
         }
         else {
-            if (node->left->left_height() > node->left->right_height()) {
-                if (verbose) {
-                    std::cout << "right" << std::endl;
-                }
-                rotate(node, RotationType::RR);
+            combined_left = combine<operation>(left, parts.less, 1);
+            combined_right = combine<operation>(right, parts.greater, 1);
+        }
+
+        if (parts.found != nil) {
+            drop(parts.found);
+        }
+        auto keep = operation == set_operation::union_of ||
+            (operation == set_operation::intersection_of) == (parts.found != nil);
+        if (keep) {
+            return join_at(combined_left, first.root, combined_right);
+        }
+        drop(first.root);
+        return concatenate(combined_left, combined_right);
+    }
+
+    template<typename K>
+    AVLTree split_off(const K& key) {
+        auto root = root_index;
+        root_index = nil;
+        auto parts = split_at({ root, height_of(root) }, key);
+        root_index = parts.less.root;
+        auto greater = parts.found == nil ? parts.greater.root : join_at({ nil, 0 }, parts.found, parts.greater).root;
+
+        AVLTree result(compare);
+        result.nodes.reserve(subtree_size(greater));
+        for (auto index = extreme(greater, 0); index != nil;) {
+            if constexpr (std::is_void<Value>::value) {
+                result.nodes.push_back(node_type{ std::move(nodes[index].key), { nil, nil }, nil, 1 });
             }
             else {
-                if (verbose) {
-                    std::cout << "left-right" << std::endl;
-                }
-                rotate(node, RotationType::LR);
+                result.nodes.push_back(node_type{ std::move(nodes[index].key), std::move(nodes[index].value), { nil, nil }, nil, 1 });
             }
+            // step reads the right child and the parents, which release_node leaves in place
+            auto next = step(index, 1);
+            release_node(index);
+            index = next;
         }
+        result.root_index = result.build_balanced(0, static_cast<std::uint32_t>(result.nodes.size()));
+        result.detach(result.root_index);
+        return result;
+    }
 
-        if (parent != nullptr) {
-            restructure(parent);
+    // copies the nodes of other behind those of this arena; returns the index of the first copied node
+    std::uint32_t append_arena(const AVLTree& other) {
+        if (other.nodes.size() > nil - nodes.size()) {
+            throw std::length_error("The tree cannot hold more nodes");
         }
+        auto offset = static_cast<std::uint32_t>(nodes.size());
+        nodes.reserve(nodes.size() + other.nodes.size());
+        for (const auto& node : other.nodes) {
+            nodes.push_back(node);
+            shift_links(nodes.back(), offset);
+        }
+        return offset;
     }
 
-    AVLNode* search(int value) {
-        AVLNode* node = root;
+    std::uint32_t append_arena(AVLTree&& other) {
+        if (other.nodes.size() > nil - nodes.size()) {
+            throw std::length_error("The tree cannot hold more nodes");
+        }
+        auto offset = static_cast<std::uint32_t>(nodes.size());
+        nodes.reserve(nodes.size() + other.nodes.size());
+        for (auto& node : other.nodes) {
+            nodes.push_back(std::move(node));
+            shift_links(nodes.back(), offset);
+        }
+        other.clear();
+        return offset;
+    }
 
-        if (node == nullptr) {
-            throw std::runtime_error("Cannot search an element in the empty tree");
+    static void shift_links(node_type& node, std::uint32_t offset) {
+        for (auto& link : node.links) {
+            link = link == nil ? nil : link + offset;
         }
+        auto parent = node.parent_balance & nil;
+        node.parent_balance = (node.parent_balance & ~nil) | (parent == nil ? nil : parent + offset);
+    }
+
+    template<set_operation operation>
+    static AVLTree combine_trees(const AVLTree& first, const AVLTree& second, size_t threads) {
+        AVLTree result(first.compare);
+        result.nodes = first.nodes;
+        auto offset = result.append_arena(second);
+        auto second_root = second.root_index == nil ? nil : second.root_index + offset;
+        result.root_index = result.combine<operation>({ first.root_index, result.height_of(first.root_index) },
+            { second_root, result.height_of(second_root) }, threads == 0 ? 1 : threads).root;
+        result.collect_free_nodes();
+        return result;
+    }
 
-        while (node != nullptr) {
-            if (node->value == value) {
-                return node;
+    void add_edges(std::uint32_t index, std::vector<std::pair<const Key*, const Key*>>& edges) const {
+        for (auto child : nodes[index].links) {
+            if (child != nil) {
+                edges.push_back(std::make_pair(&nodes[index].key, &nodes[child].key));
+                add_edges(child, edges);
             }
+        }
+    }
 
-            if (node->value < value) {
-                node = node->right;
+public:
+    AVLTree() = default;
+    explicit AVLTree(const Compare& compare) : compare(compare) {}
+
+    // builds a tree from strictly increasing keys in O(n) instead of n inserts, with the nodes in key order in the
+    // arena; a map takes (key, value) pairs. Throws std::invalid_argument if the keys are not strictly increasing
+    template<typename Iterator>
+    static AVLTree from_sorted(Iterator first, Iterator last, const Compare& compare = Compare()) {
+        AVLTree tree(compare);
+        for (; first != last; ++first) {
+            if (tree.nodes.size() == nil) {
+                throw std::length_error("The tree cannot hold more nodes");
+            }
+            if constexpr (std::is_void<Value>::value) {
+                tree.nodes.push_back(node_type{ Key(*first), { nil, nil }, nil, 1 });
             }
             else {
-                node = node->left;
+                tree.nodes.push_back(node_type{ Key(first->first), Value(first->second), { nil, nil }, nil, 1 });
+            }
+            auto count = tree.nodes.size();
+            if (count > 1 && !compare(tree.nodes[count - 2].key, tree.nodes[count - 1].key)) {
+                throw std::invalid_argument{ "The keys are not strictly increasing" };
             }
         }
 
-        return nullptr;
+        tree.root_index = tree.build_balanced(0, static_cast<std::uint32_t>(tree.nodes.size()));
+        tree.detach(tree.root_index);
+        return tree;
     }
 
-    void insert(int value) {
-        AVLNode* node = new AVLNode(value);
-        AVLNode* after = root;
-
-        if (root == nullptr) {
-            root = node;
-            return;
+    // copies the keys, and the values of a map, in key order into an immutable FrozenAVLTree for lookups that
+    // miss the cache less than a descent of the arena; the tree itself is unchanged
+    template<FrozenLayout layout = FrozenLayout::eytzinger>
+    FrozenAVLTree<Key, Value, Compare, layout> freeze() const {
+        std::vector<std::uint32_t> order;
+        order.reserve(size());
+        for (auto index = extreme(root_index, 0); index != nil; index = step(index, 1)) {
+            order.push_back(index);
         }
 
-        while (true) {
-            if (after->value < value) {
-                if (after->right == nullptr) {
-                    after->set_right_child(node);
-                    after->update_height();
-                    restructure(after);
-                    break;
-                }
-                else {
-                    after = after->right;
-                }
+        auto key_of = [this, &order](std::size_t rank) -> const Key& { return nodes[order[rank]].key; };
+        // generic, so that it is not instantiated for a set
+        auto value_of = [this, &order](auto rank) -> decltype(auto) { return (nodes[order[rank]].value); };
+        return FrozenAVLTree<Key, Value, Compare, layout>(order.size(), key_of, value_of, compare);
+    }
+
+    // value constructs the mapped value of a map and has to be empty for a set;
+    // returns false and leaves the tree unchanged if the key is already present
+    template<typename... Args>
+    bool insert(Key key, Args&&... value) {
+        static_assert(!std::is_void<Value>::value || sizeof...(Args) == 0, "A set has no mapped values");
+
+        // the subtree sizes on the path are counted up on the way down, while the nodes are in the cache,
+        // and counted down again if the key is present or the node cannot be constructed
+        auto parent = nil;
+        auto side = 0;
+        for (auto current = root_index; current != nil; current = nodes[current].links[side]) {
+            if (compare(key, nodes[current].key)) {
+                side = 0;
+            }
+            else if (compare(nodes[current].key, key)) {
+                side = 1;
             }
             else {
-                if (after->left == nullptr) {
-                    after->set_left_child(node);
-                    after->update_height();
-                    restructure(after);
-                    break;
-                }
-                else {
-                    after = after->left;
-                }
+                add_to_sizes(parent, static_cast<std::uint32_t>(-1));
+                return false;
             }
+            nodes[current].size++;
+            parent = current;
+        }
+
+        std::uint32_t index;
+        try {
+            index = allocate_node(std::move(key), parent, std::forward<Args>(value)...);
+        }
+        catch (...) {
+            add_to_sizes(parent, static_cast<std::uint32_t>(-1));
+            throw;
+        }
+        if (parent == nil) {
+            root_index = index;
+            return true;
         }
+        nodes[parent].links[side] = index;
+        retrace_growth(index);
+        return true;
     }
 
-    void single_delete(AVLNode* target_node, bool has_left_child, bool is_left) {
-        if (has_left_child) {
-            if (target_node->parent == nullptr) {
-                root = target_node->left;
-            }
-            else {
-                if (is_left) {
-                    target_node->parent->set_left_child(target_node->left);
-                }
-                else {
-                    target_node->parent->set_right_child(target_node->left);
-                }
-                target_node->parent->update_height();
+    // returns nullptr if the key is absent
+    node_type* search(const Key& key) {
+        return to_pointer(find_index(key));
+    }
+
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    node_type* search(const K& key) {
+        return to_pointer(find_index(key));
+    }
+
+    bool contains(const Key& key) const {
+        return find_index(key) != nil;
+    }
+
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    bool contains(const K& key) const {
+        return find_index(key) != nil;
+    }
+
+    // returns false if the key is absent; the slot of the erased node is reused by a later insert
+    bool erase(const Key& key) {
+        return erase_found(find_index(key));
+    }
+
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    bool erase(const K& key) {
+        return erase_found(find_index(key));
+    }
+
+    // node has to belong to this tree; its slot is reused by a later insert
+    void delete_node(node_type* node) {
+        erase_index(to_index(node));
+    }
+
+    // drops all nodes at once; the arena keeps its capacity
+    void clear() {
+        nodes.clear();
+        root_index = free_nodes = nil;
+    }
+
+    size_t size() const {
+        return subtree_size(root_index);
+    }
+
+    bool empty() const {
+        return root_index == nil;
+    }
+
+    // bytes held by the node arena, including free and reserved slots
+    size_t memory_usage() const {
+        return nodes.capacity() * sizeof(node_type);
+    }
+
+    node_type* root() {
+        return to_pointer(root_index);
+    }
+
+    node_type* left(const node_type* node) {
+        return to_pointer(node->links[0]);
+    }
+
+    node_type* right(const node_type* node) {
+        return to_pointer(node->links[1]);
+    }
+
+    node_type* parent(const node_type* node) {
+        return to_pointer(node->parent_balance & nil);
+    }
+
+    int balance_factor(const node_type* node) const {
+        return balance_of(to_index(node));
+    }
+
+    // In-order bidirectional iterator over the nodes. It holds the tree and a node index and follows the parent
+    // links, so it allocates nothing and survives inserts and erases of other nodes, even when the arena moves
+    class iterator {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = node_type*;
+        using difference_type = std::ptrdiff_t;
+        using pointer = node_type* const*;
+        using reference = node_type*;
+
+        iterator() = default;
+
+        node_type* operator*() const { return &tree->nodes[index]; }
+        node_type* operator->() const { return &tree->nodes[index]; }
+        iterator& operator++() { index = tree->step(index, 1); return *this; }
+        iterator operator++(int) { auto previous = *this; ++*this; return previous; }
+        // decrementing end() yields the last node
+        iterator& operator--() { index = index == nil ? tree->extreme(tree->root_index, 1) : tree->step(index, 0); return *this; }
+        iterator operator--(int) { auto next = *this; --*this; return next; }
+        bool operator!=(const iterator& other) const { return index != other.index; }
+        bool operator==(const iterator& other) const { return index == other.index; }
+
+    private:
+        friend class AVLTree;
+
+        AVLTree* tree = nullptr;
+        std::uint32_t index = nil;
+
+        iterator(AVLTree* tree, std::uint32_t index) : tree(tree), index(index) {}
+    };
+
+    using reverse_iterator = std::reverse_iterator<iterator>;
+
+    // a pair of iterators usable in a range-based for
+    class node_range {
+    public:
+        node_range(iterator first, iterator last) : first(first), last(last) {}
+
+        iterator begin() const { return first; }
+        iterator end() const { return last; }
+        bool empty() const { return first == last; }
+
+    private:
+        iterator first;
+        iterator last;
+    };
+
+    iterator begin() {
+        return iterator(this, extreme(root_index, 0));
+    }
+
+    iterator end() {
+        return iterator(this, nil);
+    }
+
+    reverse_iterator rbegin() {
+        return reverse_iterator(end());
+    }
+
+    reverse_iterator rend() {
+        return reverse_iterator(begin());
+    }
+
+    // first node whose key is not less than key
+    iterator lower_bound(const Key& key) {
+        return iterator(this, bound_index<false>(key));
+    }
+
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator lower_bound(const K& key) {
+        return iterator(this, bound_index<false>(key));
+    }
+
+    // first node whose key is greater than key
+    iterator upper_bound(const Key& key) {
+        return iterator(this, bound_index<true>(key));
+    }
+
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator upper_bound(const K& key) {
+        return iterator(this, bound_index<true>(key));
+    }
+
+    // the node with key, or an empty range if it is absent
+    node_range equal_range(const Key& key) {
+        return node_range(lower_bound(key), upper_bound(key));
+    }
+
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    node_range equal_range(const K& key) {
+        return node_range(lower_bound(key), upper_bound(key));
+    }
+
+    // the nodes with low <= key < high in order; costs O(log n) plus the number of nodes visited
+    node_range range(const Key& low, const Key& high) {
+        auto first = lower_bound(low);
+        return node_range(first, compare(low, high) ? lower_bound(high) : first);
+    }
+
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    node_range range(const K& low, const K& high) {
+        auto first = lower_bound(low);
+        return node_range(first, compare(low, high) ? lower_bound(high) : first);
+    }
+
+    // the node with position k in key order, counting from 0, or end() if k >= size()
+    iterator select(size_t k) {
+        auto current = root_index;
+        while (current != nil) {
+            auto left = subtree_size(nodes[current].links[0]);
+            if (k == left) {
+                break;
             }
-        }
-        else {
-            if (target_node->parent == nullptr) {
-                root = target_node->right;
+            if (k < left) {
+                current = nodes[current].links[0];
             }
             else {
-                if (is_left) {
-                    target_node->parent->set_left_child(target_node->right);
-                }
-                else {
-                    target_node->parent->set_right_child(target_node->right);
-                }
-                target_node->parent->update_height();
+                k -= left + 1;
+                current = nodes[current].links[1];
             }
         }
+        return iterator(this, current);
     }
 
-    void delete_node(AVLNode* target_node) {
-        bool is_left = target_node->is_left();
+    // number of keys less than key, which is the position of lower_bound(key)
+    size_t rank(const Key& key) const {
+        return rank_of(key);
+    }
 
-        if (target_node->left == nullptr) {
-            single_delete(target_node, false, is_left);
-            if (target_node->parent != nullptr) {
-                restructure(target_node->parent);
-            }
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    size_t rank(const K& key) const {
+        return rank_of(key);
+    }
+
+    // number of keys with low <= key < high, without visiting them
+    size_t count(const Key& low, const Key& high) const {
+        return count_between(low, high);
+    }
+
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    size_t count(const K& low, const K& high) const {
+        return count_between(low, high);
+    }
+
+    // Moves the nodes of greater, whose keys all have to follow those of this tree, into this tree. Linking the two
+    // trees takes O(log n); moving the arena of greater costs one pass over its slots.
+    // Throws std::invalid_argument if the keys overlap
+    void join(AVLTree&& greater) {
+        if (greater.empty()) {
+            return;
+        }
+        if (!empty() && (&greater == this || !compare(nodes[extreme(root_index, 1)].key, greater.nodes[greater.extreme(greater.root_index, 0)].key))) {
+            throw std::invalid_argument{ "The keys of the joined tree do not follow those of the tree" };
         }
-        else if (target_node->right == nullptr) {
-            single_delete(target_node, true, is_left);
-            if (target_node->parent != nullptr) {
-                restructure(target_node->parent);
+
+        auto first_appended = static_cast<std::uint32_t>(nodes.size());
+        auto greater_root = greater.root_index;
+        greater_root += append_arena(std::move(greater));
+        for (auto index = first_appended; index < nodes.size(); index++) {
+            if (nodes[index].size == 0) {
+                nodes[index].links[0] = free_nodes;
+                free_nodes = index;
             }
         }
-        else {
-            AVLNode* parent = target_node->parent;
-            AVLNode* left = target_node->left;
-            AVLNode* right = target_node->right;
-            bool is_left_child = target_node->is_left();
-            AVLNode* substitute = target_node->left->rightmost();
 
-            single_delete(substitute, false, substitute->parent->left == substitute);
+        auto root = root_index;
+        root_index = nil;
+        root_index = concatenate({ root, height_of(root) }, { greater_root, height_of(greater_root) }).root;
+    }
 
-            // treat the case where left = substitute separately
-            if (left == substitute) {
-                substitute->set_left_child(nullptr);
-            }
-            else {
-                substitute->set_left_child(left);
-            }
-            substitute->set_right_child(right);
+    // Moves the keys not less than key into the returned tree. Splitting takes O(log n); the returned tree gets its
+    // own arena, built in key order, which costs O(k) for its k nodes. Their slots here are reused by later inserts
+    AVLTree split(const Key& key) {
+        return split_off(key);
+    }
 
-            if (parent == nullptr) {
-                root = substitute;
-                substitute->parent = nullptr;
-            }
-            else {
-                if (is_left_child) {
-                    parent->set_left_child(substitute);
-                }
-                else {
-                    parent->set_right_child(substitute);
-                }
-            }
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    AVLTree split(const K& key) {
+        return split_off(key);
+    }
 
-            substitute->update_height();
-            restructure(substitute);
-        }
+    // Bulk set operations by recursive split and join, O(m log(n / m + 1)) for trees of n >= m keys plus one pass to
+    // copy both arenas into the result. Independent halves run on up to threads threads. Compare must not throw,
+    // and of two equal keys of a map the value of first is kept
+    static AVLTree set_union(const AVLTree& first, const AVLTree& second, size_t threads = std::thread::hardware_concurrency()) {
+        return combine_trees<set_operation::union_of>(first, second, threads);
+    }
+
+    static AVLTree set_intersection(const AVLTree& first, const AVLTree& second, size_t threads = std::thread::hardware_concurrency()) {
+        return combine_trees<set_operation::intersection_of>(first, second, threads);
+    }
+
+    // the keys of first that are not in second
+    static AVLTree set_difference(const AVLTree& first, const AVLTree& second, size_t threads = std::thread::hardware_concurrency()) {
+        return combine_trees<set_operation::difference_of>(first, second, threads);
     }
 
-    void draw() {
+    // writes the edges of the tree to out, one per line; the tree itself never writes anywhere
+    void draw(std::ostream& out) const {
         // Simple graph representation using adjacency list
-        std::vector<std::pair<int, int>> edges;
-        if (root != nullptr) {
-            root->add_edges(edges);
+        std::vector<std::pair<const Key*, const Key*>> edges;
+        if (root_index != nil) {
+            add_edges(root_index, edges);
         }
 
-        std::cout << "Tree edges (parent -> child):" << std::endl;
+        out << "Tree edges (parent -> child):\n";
         for (const auto& edge : edges) {
-            std::cout << edge.first << " -> " << edge.second << std::endl;
+            out << *edge.first << " -> " << *edge.second << '\n';
         }
-
-        // Note: For actual visualization, you would need a graph visualization library
-        // such as Graphviz C++ bindings, OGDF, or similar
-        std::cout << "Note: For graphical visualization, integrate with a graph library like Graphviz" << std::endl;
     }
 };
\ No newline at end of file
@@ -0,0 +1,626 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Concurrent AVL set after Bronson, Casper, Chafi and Olukotun, "A Practical Concurrent Binary Search Tree" (2010).
+// contains takes no locks: it descends hand over hand and validates every step against the version of the parent,
+// which a rotation changes whenever keys may leave the subtree of a node. insert and erase descend the same way and
+// lock only the nodes they change: the parent of a new leaf, or a node, its parent and the one or two children a
+// rotation moves. An erased node with two children stays in the tree as a routing node and is unlinked by a later
+// rebalance once it has at most one child; rebalancing is relaxed, so heights are repaired on the way up after the
+// change. Unlinked nodes are freed through epochs once no running operation can still hold them.
+// Compare has to be safe to call from several threads at once
+template<typename Key, typename Compare = std::less<Key>>
+class ConcurrentAVLTree {
+private:
+    // version of a node: unlinked is final; shrinking is set while a rotation moves the node down, and every
+    // finished rotation adds version_step, so a reader that saw the same version before and after a step was not
+    // overtaken by a rotation
+    static constexpr std::uint64_t unlinked = 1;
+    static constexpr std::uint64_t shrinking = 2;
+    static constexpr std::uint64_t version_step = 4;
+
+    // conditions of node_condition besides a repaired height
+    static constexpr int unlink_required = -1;
+    static constexpr int rebalance_required = -2;
+    static constexpr int nothing_required = -3;
+
+    // readers spin this often on a shrinking node before they wait for the lock of the rotation
+    static constexpr int spin_limit = 100;
+
+    struct node_base {
+        std::atomic<node_base*> links[2];
+        std::atomic<node_base*> parent;
+        std::atomic<int> height;
+        std::atomic<std::uint64_t> version;
+        // false for a routing node, whose key was erased while it had two children
+        std::atomic<bool> present;
+        std::mutex lock;
+
+        node_base(node_base* parent, int height) : parent(parent), height(height), version(0), present(true) {
+            links[0].store(nullptr);
+            links[1].store(nullptr);
+        }
+    };
+
+    struct node : node_base {
+        const Key key;
+
+        node(const Key& key, node_base* parent) : node_base(parent, 1), key(key) {}
+    };
+
+    enum class outcome {
+        no,
+        yes,
+        retry
+    };
+
+    // epochs: every operation announces the global epoch in a slot for its duration. Unlinked nodes are retired into
+    // the list of the current epoch, and the epoch advances when every announced operation has seen it. The nodes
+    // retired two epochs before are then unreachable from every running operation and are freed
+    static constexpr size_t epoch_slots = 128;
+    static constexpr std::uint64_t idle = std::numeric_limits<std::uint64_t>::max();
+    // retirements between attempts to advance the epoch, which reads every slot
+    static constexpr size_t advance_interval = 64;
+
+    struct alignas(64) epoch_slot {
+        std::atomic<bool> taken{ false };
+        std::atomic<std::uint64_t> epoch{ idle };
+    };
+
+    class guard {
+    public:
+        explicit guard(const ConcurrentAVLTree& tree) : slot(tree.enter()) {}
+        guard(const guard&) = delete;
+        guard& operator=(const guard&) = delete;
+        ~guard() {
+            slot.epoch.store(idle);
+            slot.taken.store(false);
+        }
+
+    private:
+        epoch_slot& slot;
+    };
+
+    node_base holder;
+    std::atomic<size_t> count{ 0 };
+    Compare compare;
+
+    mutable epoch_slot slots[epoch_slots];
+    std::atomic<std::uint64_t> epoch{ 0 };
+    std::mutex reclaim_lock;
+    std::vector<node*> limbo[3];
+    size_t retired_since_advance = 0;
+
+    epoch_slot& enter() const {
+        static thread_local const size_t start = std::hash<std::thread::id>()(std::this_thread::get_id());
+        for (size_t attempt = 0;; attempt++) {
+            auto& slot = slots[(start + attempt) % epoch_slots];
+            bool expected = false;
+            if (!slot.taken.load(std::memory_order_relaxed) && slot.taken.compare_exchange_strong(expected, true)) {
+                // the epoch may advance between reading and announcing it
+                auto current = epoch.load();
+                do {
+                    current = epoch.load();
+                    slot.epoch.store(current);
+                } while (epoch.load() != current);
+                return slot;
+            }
+            if (attempt % epoch_slots == epoch_slots - 1) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void retire(node* target) {
+        std::lock_guard<std::mutex> hold(reclaim_lock);
+        auto current = epoch.load();
+        limbo[current % 3].push_back(target);
+        if (++retired_since_advance < advance_interval) {
+            return;
+        }
+        for (auto& slot : slots) {
+            auto seen = slot.epoch.load();
+            if (seen != idle && seen != current) {
+                return;
+            }
+        }
+
+        retired_since_advance = 0;
+        epoch.store(current + 1);
+        auto& expired = limbo[(current + 1) % 3];
+        for (auto retired : expired) {
+            delete retired;
+        }
+        expired.clear();
+    }
+
+    static node* as_node(node_base* target) {
+        return static_cast<node*>(target);
+    }
+
+    static int height_of(node_base* target) {
+        return target == nullptr ? 0 : target->height.load();
+    }
+
+    static bool is_shrinking_or_unlinked(std::uint64_t version) {
+        return (version & (shrinking | unlinked)) != 0;
+    }
+
+    static void wait_until_not_shrinking(node_base* target) {
+        auto version = target->version.load();
+        if ((version & shrinking) == 0) {
+            return;
+        }
+        for (int spin = 0; spin < spin_limit; spin++) {
+            if (target->version.load() != version) {
+                return;
+            }
+        }
+        // the rotation holds the lock of the node until it is done
+        std::lock_guard<std::mutex> wait(target->lock);
+    }
+
+    // 0 or 1 for the side of target key belongs to, -1 if target has key
+    int side_of(const Key& key, node_base* target) const {
+        const auto& other = as_node(target)->key;
+        if (compare(key, other)) {
+            return 0;
+        }
+        if (compare(other, key)) {
+            return 1;
+        }
+        return -1;
+    }
+
+    // target had the given version when its parent pointed to it; key belongs to the subtree on side of target
+    outcome attempt_contains(const Key& key, node_base* target, int side, std::uint64_t version) const {
+        for (;;) {
+            auto child = target->links[side].load();
+            if (child == nullptr) {
+                return target->version.load() == version ? outcome::no : outcome::retry;
+            }
+
+            auto child_side = side_of(key, child);
+            if (child_side < 0) {
+                return child->present.load() ? outcome::yes : outcome::no;
+            }
+            auto child_version = child->version.load();
+            if (is_shrinking_or_unlinked(child_version)) {
+                wait_until_not_shrinking(child);
+                if (target->version.load() != version) {
+                    return outcome::retry;
+                }
+            }
+            else if (child != target->links[side].load()) {
+                if (target->version.load() != version) {
+                    return outcome::retry;
+                }
+            }
+            else {
+                if (target->version.load() != version) {
+                    return outcome::retry;
+                }
+                auto result = attempt_contains(key, child, child_side, child_version);
+                if (result != outcome::retry) {
+                    return result;
+                }
+            }
+        }
+    }
+
+    outcome update(const Key& key, bool insert) {
+        for (;;) {
+            auto root = holder.links[1].load();
+            if (root == nullptr) {
+                if (!insert) {
+                    return outcome::no;
+                }
+                std::lock_guard<std::mutex> hold(holder.lock);
+                if (holder.links[1].load() == nullptr) {
+                    holder.links[1].store(new node(key, &holder));
+                    return outcome::yes;
+                }
+                continue;
+            }
+
+            auto version = root->version.load();
+            if (is_shrinking_or_unlinked(version)) {
+                wait_until_not_shrinking(root);
+            }
+            else if (root == holder.links[1].load()) {
+                auto result = attempt_update(key, insert, &holder, root, version);
+                if (result != outcome::retry) {
+                    return result;
+                }
+            }
+        }
+    }
+
+    outcome attempt_update(const Key& key, bool insert, node_base* parent, node_base* target, std::uint64_t version) {
+        auto side = side_of(key, target);
+        if (side < 0) {
+            return attempt_node_update(insert, parent, target);
+        }
+
+        for (;;) {
+            auto child = target->links[side].load();
+            if (target->version.load() != version) {
+                return outcome::retry;
+            }
+
+            if (child == nullptr) {
+                if (!insert) {
+                    return outcome::no;
+                }
+                node_base* damaged;
+                {
+                    std::lock_guard<std::mutex> hold(target->lock);
+                    if (target->version.load() != version) {
+                        return outcome::retry;
+                    }
+                    if (target->links[side].load() != nullptr) {
+                        continue;
+                    }
+                    target->links[side].store(new node(key, target));
+                    damaged = fix_height(target);
+                }
+                fix_height_and_rebalance(damaged);
+                return outcome::yes;
+            }
+
+            auto child_version = child->version.load();
+            if (is_shrinking_or_unlinked(child_version)) {
+                wait_until_not_shrinking(child);
+            }
+            else if (child == target->links[side].load()) {
+                if (target->version.load() != version) {
+                    return outcome::retry;
+                }
+                auto result = attempt_update(key, insert, target, child, child_version);
+                if (result != outcome::retry) {
+                    return result;
+                }
+            }
+        }
+    }
+
+    // target has the key; an erase unlinks it if it has at most one child and makes it a routing node otherwise
+    outcome attempt_node_update(bool insert, node_base* parent, node_base* target) {
+        if (!insert) {
+            if (!target->present.load()) {
+                return outcome::no;
+            }
+            if (target->links[0].load() == nullptr || target->links[1].load() == nullptr) {
+                node_base* damaged;
+                {
+                    std::lock_guard<std::mutex> hold_parent(parent->lock);
+                    if ((parent->version.load() & unlinked) != 0 || target->parent.load() != parent) {
+                        return outcome::retry;
+                    }
+                    {
+                        std::lock_guard<std::mutex> hold(target->lock);
+                        if (!target->present.load()) {
+                            return outcome::no;
+                        }
+                        if (!attempt_unlink(parent, target)) {
+                            return outcome::retry;
+                        }
+                    }
+                    damaged = fix_height(parent);
+                }
+                fix_height_and_rebalance(damaged);
+                return outcome::yes;
+            }
+        }
+
+        std::lock_guard<std::mutex> hold(target->lock);
+        if ((target->version.load() & unlinked) != 0) {
+            return outcome::retry;
+        }
+        if (!insert && (target->links[0].load() == nullptr || target->links[1].load() == nullptr)) {
+            // a child was unlinked meanwhile, so target has to be unlinked instead
+            return outcome::retry;
+        }
+        auto was_present = target->present.load();
+        target->present.store(insert);
+        return was_present != insert ? outcome::yes : outcome::no;
+    }
+
+    // parent and target are locked
+    bool attempt_unlink(node_base* parent, node_base* target) {
+        auto parent_left = parent->links[0].load();
+        if (parent_left != target && parent->links[1].load() != target) {
+            return false;
+        }
+        auto left = target->links[0].load();
+        auto right = target->links[1].load();
+        if (left != nullptr && right != nullptr) {
+            return false;
+        }
+
+        auto splice = left != nullptr ? left : right;
+        parent->links[parent_left == target ? 0 : 1].store(splice);
+        if (splice != nullptr) {
+            splice->parent.store(parent);
+        }
+        target->version.store(unlinked);
+        target->present.store(false);
+        retire(as_node(target));
+        return true;
+    }
+
+    // the repaired height of target, or one of the conditions
+    int node_condition(node_base* target) const {
+        auto left = target->links[0].load();
+        auto right = target->links[1].load();
+        if ((left == nullptr || right == nullptr) && !target->present.load()) {
+            return unlink_required;
+        }
+
+        auto left_height = height_of(left);
+        auto right_height = height_of(right);
+        auto balance = left_height - right_height;
+        if (balance < -1 || balance > 1) {
+            return rebalance_required;
+        }
+        auto repaired = 1 + std::max(left_height, right_height);
+        return target->height.load() != repaired ? repaired : nothing_required;
+    }
+
+    // target is locked; returns the next node to repair, if any
+    node_base* fix_height(node_base* target) {
+        auto condition = node_condition(target);
+        switch (condition) {
+        case unlink_required:
+        case rebalance_required:
+            return target;
+        case nothing_required:
+            return nullptr;
+        default:
+            target->height.store(condition);
+            return target->parent.load();
+        }
+    }
+
+    void fix_height_and_rebalance(node_base* target) {
+        // the holder has no parent and ends the repair
+        while (target != nullptr && target->parent.load() != nullptr) {
+            auto condition = node_condition(target);
+            if (condition == nothing_required || (target->version.load() & unlinked) != 0) {
+                return;
+            }
+
+            if (condition != unlink_required && condition != rebalance_required) {
+                std::lock_guard<std::mutex> hold(target->lock);
+                target = fix_height(target);
+            }
+            else {
+                auto parent = target->parent.load();
+                std::lock_guard<std::mutex> hold_parent(parent->lock);
+                if ((parent->version.load() & unlinked) == 0 && target->parent.load() == parent) {
+                    std::lock_guard<std::mutex> hold(target->lock);
+                    target = rebalance(parent, target);
+                }
+            }
+        }
+    }
+
+    // parent and target are locked
+    node_base* rebalance(node_base* parent, node_base* target) {
+        auto left = target->links[0].load();
+        auto right = target->links[1].load();
+        if ((left == nullptr || right == nullptr) && !target->present.load()) {
+            return attempt_unlink(parent, target) ? fix_height(parent) : target;
+        }
+
+        auto left_height = height_of(left);
+        auto right_height = height_of(right);
+        auto balance = left_height - right_height;
+        if (balance > 1) {
+            return rebalance_towards(parent, target, 0, left, right_height);
+        }
+        if (balance < -1) {
+            return rebalance_towards(parent, target, 1, right, left_height);
+        }
+        auto repaired = 1 + std::max(left_height, right_height);
+        if (target->height.load() != repaired) {
+            target->height.store(repaired);
+            return fix_height(parent);
+        }
+        return nullptr;
+    }
+
+    // target, locked with its parent, is too tall on side heavy, where child is; light_height is the height of
+    // its other subtree. Rotates child, or the inner grandchild, into the place of target
+    node_base* rebalance_towards(node_base* parent, node_base* target, int heavy, node_base* child, int light_height) {
+        std::lock_guard<std::mutex> hold(child->lock);
+        if (child->height.load() - light_height <= 1) {
+            return target;
+        }
+
+        auto inner = child->links[1 - heavy].load();
+        auto outer_height = height_of(child->links[heavy].load());
+        auto inner_height = height_of(inner);
+        if (outer_height >= inner_height) {
+            return rotate(parent, target, heavy, child, light_height, outer_height, inner, inner_height);
+        }
+
+        {
+            std::lock_guard<std::mutex> hold_inner(inner->lock);
+            inner_height = inner->height.load();
+            if (outer_height >= inner_height) {
+                return rotate(parent, target, heavy, child, light_height, outer_height, inner, inner_height);
+            }
+            auto inner_outer_height = height_of(inner->links[heavy].load());
+            auto balance = outer_height - inner_outer_height;
+            if (balance >= -1 && balance <= 1 && !((outer_height == 0 || inner_outer_height == 0) && !child->present.load())) {
+                return rotate_double(parent, target, heavy, child, light_height, outer_height, inner, inner_outer_height);
+            }
+        }
+        // child leans the other way too much for a double rotation, so child is rotated first
+        return rebalance_towards(target, child, 1 - heavy, inner, outer_height);
+    }
+
+    static std::uint64_t end_change(std::uint64_t version) {
+        return (version & ~shrinking) + version_step;
+    }
+
+    // child takes the place of target, which shrinks to the subtrees inner and the light one
+    node_base* rotate(node_base* parent, node_base* target, int heavy, node_base* child, int light_height,
+        int outer_height, node_base* inner, int inner_height) {
+        auto light = 1 - heavy;
+        auto version = target->version.load();
+        auto parent_side = parent->links[0].load() == target ? 0 : 1;
+
+        target->version.store(version | shrinking);
+        target->links[heavy].store(inner);
+        if (inner != nullptr) {
+            inner->parent.store(target);
+        }
+        child->links[light].store(target);
+        target->parent.store(child);
+        parent->links[parent_side].store(child);
+        child->parent.store(parent);
+
+        auto target_height = 1 + std::max(inner_height, light_height);
+        target->height.store(target_height);
+        child->height.store(1 + std::max(outer_height, target_height));
+        target->version.store(end_change(version));
+
+        auto target_balance = inner_height - light_height;
+        if (target_balance < -1 || target_balance > 1 || ((inner == nullptr || light_height == 0) && !target->present.load())) {
+            return target;
+        }
+        auto child_balance = outer_height - target_height;
+        if (child_balance < -1 || child_balance > 1 || (outer_height == 0 && !child->present.load())) {
+            return child;
+        }
+        return fix_height(parent);
+    }
+
+    // inner, the inner child of child, takes the place of target; target and child both shrink
+    node_base* rotate_double(node_base* parent, node_base* target, int heavy, node_base* child, int light_height,
+        int outer_height, node_base* inner, int inner_outer_height) {
+        auto light = 1 - heavy;
+        auto version = target->version.load();
+        auto child_version = child->version.load();
+        auto parent_side = parent->links[0].load() == target ? 0 : 1;
+        auto inner_outer = inner->links[heavy].load();
+        auto inner_inner = inner->links[light].load();
+        auto inner_inner_height = height_of(inner_inner);
+
+        target->version.store(version | shrinking);
+        child->version.store(child_version | shrinking);
+        target->links[heavy].store(inner_inner);
+        if (inner_inner != nullptr) {
+            inner_inner->parent.store(target);
+        }
+        child->links[light].store(inner_outer);
+        if (inner_outer != nullptr) {
+            inner_outer->parent.store(child);
+        }
+        inner->links[heavy].store(child);
+        child->parent.store(inner);
+        inner->links[light].store(target);
+        target->parent.store(inner);
+        parent->links[parent_side].store(inner);
+        inner->parent.store(parent);
+
+        auto target_height = 1 + std::max(inner_inner_height, light_height);
+        auto child_height = 1 + std::max(outer_height, inner_outer_height);
+        target->height.store(target_height);
+        child->height.store(child_height);
+        inner->height.store(1 + std::max(child_height, target_height));
+        target->version.store(end_change(version));
+        child->version.store(end_change(child_version));
+
+        auto target_balance = inner_inner_height - light_height;
+        if (target_balance < -1 || target_balance > 1 || ((inner_inner == nullptr || light_height == 0) && !target->present.load())) {
+            return target;
+        }
+        auto inner_balance = child_height - target_height;
+        if (inner_balance < -1 || inner_balance > 1) {
+            return inner;
+        }
+        return fix_height(parent);
+    }
+
+    static void destroy(node_base* target) {
+        if (target != nullptr) {
+            destroy(target->links[0].load());
+            destroy(target->links[1].load());
+            delete as_node(target);
+        }
+    }
+
+public:
+    ConcurrentAVLTree() : holder(nullptr, 0) {}
+    explicit ConcurrentAVLTree(const Compare& compare) : holder(nullptr, 0), compare(compare) {}
+    ConcurrentAVLTree(const ConcurrentAVLTree&) = delete;
+    ConcurrentAVLTree& operator=(const ConcurrentAVLTree&) = delete;
+
+    // no operation may be running
+    ~ConcurrentAVLTree() {
+        destroy(holder.links[1].load());
+        for (auto& retired : limbo) {
+            for (auto target : retired) {
+                delete target;
+            }
+        }
+    }
+
+    // the search of the tree; takes no lock unless it has to wait for a rotation of a node on its path
+    bool contains(const Key& key) const {
+        guard active(*this);
+        auto root_holder = const_cast<node_base*>(&holder);
+        for (;;) {
+            auto result = attempt_contains(key, root_holder, 1, 0);
+            if (result != outcome::retry) {
+                return result == outcome::yes;
+            }
+        }
+    }
+
+    // returns false if the key is already present
+    bool insert(const Key& key) {
+        guard active(*this);
+        if (update(key, true) != outcome::yes) {
+            return false;
+        }
+        count++;
+        return true;
+    }
+
+    // returns false if the key is absent
+    bool erase(const Key& key) {
+        guard active(*this);
+        if (update(key, false) != outcome::yes) {
+            return false;
+        }
+        count--;
+        return true;
+    }
+
+    // exact when no update is running
+    size_t size() const {
+        return count.load();
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    // height of the tree, for tests; no update may be running
+    int height() const {
+        return height_of(holder.links[1].load());
+    }
+};
@@ -0,0 +1,302 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "child_selection.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// how FrozenAVLTree lays out its keys:
+// eytzinger stores the implicit binary search tree in BFS order, the children of slot k at 2k and 2k + 1, so the
+// descendants of a slot log2(64 / sizeof(Key)) levels down, at most four, share one cache line that the search
+// prefetches while it compares: four levels for 4-byte keys, three for 8-byte keys;
+// blocks stores a 17-ary search tree of 16-key blocks in BFS order, a block of 16 * sizeof(Key) bytes per level,
+// one cache line for ints, and ranks the key within a block with AVX2 when Key is int
+enum class FrozenLayout {
+    eytzinger,
+    blocks
+};
+
+// Immutable sorted set (Value = void) or map in one contiguous array, built by AVLTree::freeze or from_sorted for
+// indexes that are built once and then only queried. The descent compares without branching on the result and
+// visits no pointers, so a lookup costs about one cache miss per level of the live tree for eytzinger; blocks
+// reads 16 * sizeof(Key) / 64 cache lines per four levels, one line for 4-byte keys
+template<typename Key, typename Value = void, typename Compare = std::less<Key>, FrozenLayout layout = FrozenLayout::eytzinger>
+class FrozenAVLTree {
+private:
+    static constexpr std::size_t cache_line = 64;
+    static constexpr std::size_t block_keys = 16;
+    // slot distance between a node and the descendants that fill one cache line: 64 / sizeof(Key), which is four
+    // levels down for 4-byte keys and three for 8-byte keys, at most 16 slots
+    static constexpr std::size_t prefetch_stride = cache_line / sizeof(Key) > 16 ? 16 : cache_line / sizeof(Key) > 0 ? cache_line / sizeof(Key) : 1;
+    // returned by the blocks descent when every key is less than the probe
+    static constexpr std::size_t npos = ~std::size_t(0);
+
+    static constexpr bool int_keys = std::is_same<Key, int>::value
+        && (std::is_same<Compare, std::less<int>>::value || std::is_same<Compare, std::less<>>::value);
+
+    // keeps the slots on cache line boundaries, so the prefetched line and a block are one line each
+    template<typename T>
+    struct aligned_allocator {
+        using value_type = T;
+
+        aligned_allocator() = default;
+        template<typename U>
+        aligned_allocator(const aligned_allocator<U>&) {}
+
+        T* allocate(std::size_t count) {
+            return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(cache_line)));
+        }
+
+        void deallocate(T* slots, std::size_t) {
+            ::operator delete(slots, std::align_val_t(cache_line));
+        }
+
+        bool operator==(const aligned_allocator&) const { return true; }
+        bool operator!=(const aligned_allocator&) const { return false; }
+    };
+
+    struct no_values {
+        std::size_t capacity() const { return 0; }
+    };
+    using value_storage = typename std::conditional<std::is_void<Value>::value, no_values,
+        std::vector<typename std::conditional<std::is_void<Value>::value, char, Value>::type>>::type;
+
+    // slot k of eytzinger is keys[k] and keys[0] holds a copy of the smallest key, so Key needs no default
+    // constructor; blocks pads its last block with copies of the largest key, which come after the real one in
+    // key order and are never the first key not less than a probe
+    std::vector<Key, aligned_allocator<Key>> keys;
+    value_storage values;
+    std::size_t count = 0;
+    Compare compare;
+    bool simd = false;
+
+    template<typename, typename, typename>
+    friend class AVLTree;
+
+    static void prefetch(const void* address) {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(address);
+#elif defined(HEAP_SIMD_X86)
+        _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+        (void)address;
+#endif
+    }
+
+    // bits always has a clear bit, as slots stay below 2^63
+    static unsigned trailing_ones(std::uint64_t bits) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+        unsigned long index;
+        _BitScanForward64(&index, ~bits);
+        return index;
+#elif defined(_MSC_VER)
+        // 32-bit targets have no 64-bit bit scan
+        unsigned long index;
+        if (_BitScanForward(&index, static_cast<unsigned long>(~bits))) {
+            return index;
+        }
+        _BitScanForward(&index, static_cast<unsigned long>(~bits >> 32));
+        return index + 32;
+#else
+        return static_cast<unsigned>(__builtin_ctzll(~bits));
+#endif
+    }
+
+    // ranks[slot] is the position in key order of the key stored in slot; the in-order walk of the implicit tree
+    // only touches indices, and its depth is the height of the layout
+    void eytzinger_ranks(std::size_t slot, std::size_t& next, std::vector<std::size_t>& ranks) const {
+        if (slot <= count) {
+            eytzinger_ranks(2 * slot, next, ranks);
+            ranks[slot] = next++;
+            eytzinger_ranks(2 * slot + 1, next, ranks);
+        }
+    }
+
+    void block_ranks(std::size_t block, std::size_t block_count, std::size_t& next, std::vector<std::size_t>& ranks) const {
+        if (block < block_count) {
+            for (std::size_t i = 0; i < block_keys; i++) {
+                block_ranks(block * (block_keys + 1) + i + 1, block_count, next, ranks);
+                ranks[block * block_keys + i] = next < count ? next : count - 1;
+                next++;
+            }
+            block_ranks(block * (block_keys + 1) + block_keys + 1, block_count, next, ranks);
+        }
+    }
+
+    // key_at(rank) and value_at(rank) return the element of rank in key order
+    template<typename KeyAt, typename ValueAt>
+    FrozenAVLTree(std::size_t count, KeyAt&& key_at, ValueAt&& value_at, const Compare& compare)
+        : count(count), compare(compare) {
+        if (count == 0) {
+            return;
+        }
+
+        std::vector<std::size_t> ranks;
+        std::size_t next = 0;
+        if constexpr (layout == FrozenLayout::eytzinger) {
+            ranks.resize(count + 1);
+            eytzinger_ranks(1, next, ranks);
+            ranks[0] = 0;
+        }
+        else {
+            auto block_count = (count + block_keys - 1) / block_keys;
+            ranks.resize(block_count * block_keys);
+            block_ranks(0, block_count, next, ranks);
+        }
+
+        keys.reserve(ranks.size());
+        for (auto rank : ranks) {
+            keys.push_back(key_at(rank));
+        }
+        if constexpr (!std::is_void<Value>::value) {
+            values.reserve(ranks.size());
+            for (auto rank : ranks) {
+                values.push_back(value_at(rank));
+            }
+        }
+
+#ifdef HEAP_SIMD_X86
+        if constexpr (int_keys && layout == FrozenLayout::blocks) {
+            simd = heap::simd::has_avx2();
+        }
+#endif
+    }
+
+#ifdef HEAP_SIMD_X86
+    // the block is sorted, so the lanes less than key are a prefix and its length is the first clear bit of the mask
+    HEAP_TARGET_AVX2 static std::size_t rank_avx2(const int* block, int key) {
+        auto probe = _mm256_set1_epi32(key);
+        auto low = _mm256_cmpgt_epi32(probe, _mm256_load_si256(reinterpret_cast<const __m256i*>(block)));
+        auto high = _mm256_cmpgt_epi32(probe, _mm256_load_si256(reinterpret_cast<const __m256i*>(block + 8)));
+        auto mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(low)))
+            | static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(high))) << 8;
+        return heap::simd::first_set(~mask);
+    }
+#endif
+
+    // number of keys in the block less than key
+    std::size_t rank_in_block(const Key* block, const Key& key) const {
+#ifdef HEAP_SIMD_X86
+        if constexpr (int_keys) {
+            if (simd) {
+                return rank_avx2(block, key);
+            }
+        }
+#endif
+        std::size_t rank = 0;
+        for (std::size_t i = 0; i < block_keys; i++) {
+            rank += compare(block[i], key);
+        }
+        return rank;
+    }
+
+    // slot of the first key not less than key: 0 for eytzinger and npos for blocks if there is none
+    std::size_t bound_slot(const Key& key) const {
+        if constexpr (layout == FrozenLayout::eytzinger) {
+            auto base = reinterpret_cast<std::uintptr_t>(keys.data());
+            std::size_t slot = 1;
+            while (slot <= count) {
+                // may point past the array; a prefetch does not fault
+                prefetch(reinterpret_cast<const void*>(base + prefetch_stride * slot * sizeof(Key)));
+                slot = 2 * slot + compare(keys[slot], key);
+            }
+            // the right turns after the last left turn are trailing ones; dropping them and the left turn yields the
+            // last node passed on its left, the first key not less than key
+            return slot >> (trailing_ones(slot) + 1);
+        }
+        else {
+            auto block_count = keys.size() / block_keys;
+            auto found = npos;
+            for (std::size_t block = 0; block < block_count;) {
+                auto rank = rank_in_block(keys.data() + block * block_keys, key);
+                found = rank < block_keys ? block * block_keys + rank : found;
+                block = block * (block_keys + 1) + rank + 1;
+            }
+            return found;
+        }
+    }
+
+    bool found(std::size_t slot) const {
+        if constexpr (layout == FrozenLayout::eytzinger) {
+            return slot != 0;
+        }
+        else {
+            return slot != npos;
+        }
+    }
+
+public:
+    FrozenAVLTree() = default;
+
+    // builds the layout from strictly increasing keys; a map takes (key, value) pairs.
+    // Throws std::invalid_argument if the keys are not strictly increasing
+    template<typename Iterator>
+    static FrozenAVLTree from_sorted(Iterator first, Iterator last, const Compare& compare = Compare()) {
+        using element = typename std::conditional<std::is_void<Value>::value, Key,
+            std::pair<Key, typename std::conditional<std::is_void<Value>::value, char, Value>::type>>::type;
+        std::vector<element> sorted(first, last);
+        auto key_of = [&sorted](std::size_t rank) -> const Key& {
+            if constexpr (std::is_void<Value>::value) {
+                return sorted[rank];
+            }
+            else {
+                return sorted[rank].first;
+            }
+        };
+        for (std::size_t rank = 1; rank < sorted.size(); rank++) {
+            if (!compare(key_of(rank - 1), key_of(rank))) {
+                throw std::invalid_argument{ "The keys are not strictly increasing" };
+            }
+        }
+
+        // generic, so that it is not instantiated for a set
+        auto value_of = [&sorted](auto rank) -> decltype(auto) { return (sorted[rank].second); };
+        return FrozenAVLTree(sorted.size(), key_of, value_of, compare);
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    // bytes held by the key and value arrays
+    size_t memory_usage() const {
+        size_t bytes = keys.capacity() * sizeof(Key);
+        if constexpr (!std::is_void<Value>::value) {
+            bytes += values.capacity() * sizeof(Value);
+        }
+        return bytes;
+    }
+
+    bool contains(const Key& key) const {
+        auto slot = bound_slot(key);
+        return found(slot) && !compare(key, keys[slot]);
+    }
+
+    // first key not less than key, nullptr if every key is less
+    const Key* lower_bound(const Key& key) const {
+        auto slot = bound_slot(key);
+        return found(slot) ? &keys[slot] : nullptr;
+    }
+
+    // value of key in a map, nullptr if the key is absent
+    template<typename V = Value, typename = typename std::enable_if<!std::is_void<V>::value>::type>
+    const V* search(const Key& key) const {
+        auto slot = bound_slot(key);
+        return found(slot) && !compare(key, keys[slot]) ? &values[slot] : nullptr;
+    }
+};
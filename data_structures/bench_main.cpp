@@ -0,0 +1,211 @@
+#include "stdafx.h"
+
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark.h"
+
+using namespace std;
+extern vector<benchmark::benchmark_case> make_suite(const vector<size_t>& sizes);
+extern void run_benchmarks();
+
+static const char* usage =
+	"usage: bench [options]\n"
+	"  --filter TEXT        run only the cases whose name contains TEXT, e.g. heap_sort/sort/int\n"
+	"  --sizes N,N,...      element counts, 1000,100000 by default\n"
+	"  --repetitions N      measured runs per case, 10 by default\n"
+	"  --warmup N           unmeasured runs per case, 1 by default\n"
+	"  --out FILE           write the JSON report to FILE instead of stdout\n"
+	"  --baseline FILE      compare the medians with an earlier report, exit with 2 on a regression\n"
+	"  --threshold FRACTION slowdown counted as a regression, 0.1 by default\n"
+	"  --list               print the case names and exit\n"
+	"  --report             run the human-readable benchmarks instead\n";
+
+static vector<size_t> parse_sizes(const string& text)
+{
+	vector<size_t> sizes;
+	size_t start = 0;
+	while (start <= text.size())
+	{
+		auto end = text.find(',', start);
+		if (end == string::npos)
+		{
+			end = text.size();
+		}
+		sizes.push_back(stoull(text.substr(start, end - start)));
+		start = end + 1;
+	}
+	return sizes;
+}
+
+static string compiler_name()
+{
+#if defined(__clang__)
+	return "clang " __clang_version__;
+#elif defined(__GNUC__)
+	return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+	return "msvc " + to_string(_MSC_VER);
+#else
+	return "unknown";
+#endif
+}
+
+static string timestamp()
+{
+	auto now = time(nullptr);
+	char text[32];
+	strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+	return text;
+}
+
+int main(int argc, char** argv)
+{
+	string filter, out_path, baseline_path;
+	vector<size_t> sizes = { 1000, 100000 };
+	size_t repetitions = 10, warmup = 1;
+	double threshold = 0.1;
+	bool list_only = false;
+
+	try
+	{
+		for (int index = 1; index < argc; index++)
+		{
+			string option = argv[index];
+			auto value = [&]()
+				{
+					if (index + 1 == argc)
+					{
+						throw invalid_argument{ option + " requires a value" };
+					}
+					return string(argv[++index]);
+				};
+
+			if (option == "--filter")
+			{
+				filter = value();
+			}
+			else if (option == "--sizes")
+			{
+				sizes = parse_sizes(value());
+			}
+			else if (option == "--repetitions")
+			{
+				repetitions = stoull(value());
+			}
+			else if (option == "--warmup")
+			{
+				warmup = stoull(value());
+			}
+			else if (option == "--out")
+			{
+				out_path = value();
+			}
+			else if (option == "--baseline")
+			{
+				baseline_path = value();
+			}
+			else if (option == "--threshold")
+			{
+				threshold = stod(value());
+			}
+			else if (option == "--list")
+			{
+				list_only = true;
+			}
+			else if (option == "--report")
+			{
+				run_benchmarks();
+				return 0;
+			}
+			else
+			{
+				cerr << usage;
+				return option == "--help" ? 0 : 1;
+			}
+		}
+
+		vector<benchmark::benchmark_case> selected;
+		for (auto& target : make_suite(sizes))
+		{
+			if (target.name().find(filter) != string::npos)
+			{
+				selected.push_back(target);
+			}
+		}
+
+		if (list_only)
+		{
+			for (auto& target : selected)
+			{
+				cout << target.name() << endl;
+			}
+			return 0;
+		}
+
+		//progress goes to stderr so that stdout stays a valid report
+		vector<benchmark::result> results;
+		for (auto& target : selected)
+		{
+			results.push_back(benchmark::run(target, repetitions, warmup));
+			auto& measured = results.back();
+			cerr << target.name() << ": median " << measured.summary.median / 1e6 << " ms";
+			if (!measured.cache_misses.empty())
+			{
+				cerr << ", " << benchmark::summarize(measured.cache_misses).median << " cache misses";
+			}
+			cerr << endl;
+		}
+
+		vector<const benchmark::result*> regressions;
+		if (!baseline_path.empty())
+		{
+			regressions = benchmark::compare(results, benchmark::read_baseline(baseline_path), threshold);
+		}
+
+		vector<pair<string, string>> context = {
+			{ "date", timestamp() },
+			{ "compiler", compiler_name() },
+#ifdef NDEBUG
+			{ "build_type", "release" },
+#else
+			{ "build_type", "debug" },
+#endif
+			{ "hardware_concurrency", to_string(thread::hardware_concurrency()) },
+			{ "repetitions", to_string(repetitions) },
+			{ "warmup", to_string(warmup) },
+			{ "baseline", baseline_path }
+		};
+
+		if (out_path.empty())
+		{
+			benchmark::write_json(cout, results, context);
+		}
+		else
+		{
+			ofstream out(out_path);
+			if (!out)
+			{
+				throw runtime_error{ "Cannot create " + out_path };
+			}
+			benchmark::write_json(out, results, context);
+		}
+
+		for (auto regression : regressions)
+		{
+			cerr << "regression: " << regression->target.name() << " median " << regression->summary.median / 1e6 <<
+				" ms, baseline " << regression->baseline_median / 1e6 << " ms" << endl;
+		}
+		return regressions.empty() ? 0 : 2;
+	}
+	catch (const exception& error)
+	{
+		cerr << "bench: " << error.what() << endl << usage;
+		return 1;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,586 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "AVLTree.h"
+#include "benchmark.h"
+#include "FrozenAVLTree.h"
+#include "gcd.h"
+#include "heap.h"
+#include "legacy_avl_tree.h"
+#include "min_max_heap.h"
+#include "sequence_heap.h"
+#include "three_way_disjoint.h"
+
+using namespace std;
+using benchmark::benchmark_case;
+using benchmark::muted_output;
+
+static const vector<string> patterns = { "random", "ascending", "descending", "few_unique" };
+
+//keeps the results of the measured calls observable so they are not optimized away
+static volatile long long sink;
+
+static vector<unsigned> pattern_keys(const string& pattern, size_t size, unsigned seed)
+{
+	mt19937 gen(seed);
+	vector<unsigned> keys(size);
+	for (size_t index = 0; index < size; index++)
+	{
+		if (pattern == "random")
+		{
+			keys[index] = gen() >> 1;
+		}
+		else if (pattern == "ascending")
+		{
+			keys[index] = unsigned(index);
+		}
+		else if (pattern == "descending")
+		{
+			keys[index] = unsigned(size - index);
+		}
+		else
+		{
+			keys[index] = gen() % 16;
+		}
+	}
+	return keys;
+}
+
+template<typename T>
+static T make_element(unsigned key);
+
+template<>
+int make_element<int>(unsigned key)
+{
+	return int(key);
+}
+
+template<>
+pair<int, int> make_element<pair<int, int>>(unsigned key)
+{
+	return { int(key), int((key * 2654435761u) >> 1) };
+}
+
+//zero-padded, so strings compare in the order of their keys after a common prefix
+template<>
+string make_element<string>(unsigned key)
+{
+	auto digits = to_string(key);
+	return "element-" + string(10 - digits.size(), '0') + digits;
+}
+
+template<typename T>
+static const char* element_name();
+
+template<>
+const char* element_name<int>()
+{
+	return "int";
+}
+
+template<>
+const char* element_name<pair<int, int>>()
+{
+	return "pair<int,int>";
+}
+
+template<>
+const char* element_name<string>()
+{
+	return "string";
+}
+
+template<typename T>
+static shared_ptr<const vector<T>> make_input(const string& pattern, size_t size, unsigned seed = 1)
+{
+	auto keys = pattern_keys(pattern, size, seed);
+	auto elements = make_shared<vector<T>>();
+	elements->reserve(size);
+	for (auto key : keys)
+	{
+		elements->push_back(make_element<T>(key));
+	}
+	return elements;
+}
+
+template<typename T, size_t arity>
+static void add_heap_cases(vector<benchmark_case>& suite, const string& pattern, size_t size)
+{
+	using interface = heap::interface<T, less<T>, arity>;
+	auto structure = "heap<" + to_string(arity) + ">";
+
+	suite.push_back({ structure, "build", element_name<T>(), pattern, size, [pattern, size]()
+		{
+			auto input = make_input<T>(pattern, size);
+			auto data = make_shared<vector<T>>(*input);
+			return function<void()>([data]() { heap::heap<T, less<T>, arity> built{ *data }; });
+		} });
+	suite.push_back({ structure, "insert", element_name<T>(), pattern, size, [pattern, size]()
+		{
+			auto input = make_input<T>(pattern, size);
+			auto data = make_shared<vector<T>>();
+			data->reserve(input->size());
+			return function<void()>([input, data]()
+				{
+					heap::heap<T, less<T>, arity> target{ *data };
+					for (auto& value : *input)
+					{
+						target.insert(value);
+					}
+				});
+		} });
+	suite.push_back({ structure, "remove", element_name<T>(), pattern, size, [pattern, size]()
+		{
+			auto input = make_input<T>(pattern, size);
+			auto data = make_shared<vector<T>>(*input);
+			interface::make_valid(*data);
+			return function<void()>([data]()
+				{
+					while (!data->empty())
+					{
+						interface::remove(*data);
+					}
+				});
+		} });
+}
+
+template<typename T>
+struct wrapper_state
+{
+	heap::stable_storage<T> data;
+	heap::heap_wrapper<T> wrapper;
+
+	explicit wrapper_state(const vector<T>& input)
+		: data(input.begin(), input.end()), wrapper(data)
+	{
+
+	}
+};
+
+template<typename T>
+struct min_max_state
+{
+	vector<T> data;
+	heap::min_max_heap<T> target;
+
+	explicit min_max_state(const vector<T>& input)
+		: data(input), target(data)
+	{
+
+	}
+};
+
+template<typename T>
+static void add_heap_family_cases(vector<benchmark_case>& suite, const string& pattern, size_t size)
+{
+	add_heap_cases<T, 2>(suite, pattern, size);
+	add_heap_cases<T, 4>(suite, pattern, size);
+
+	auto element = element_name<T>();
+
+	suite.push_back({ "sequence_heap", "insert", element, pattern, size, [pattern, size]()
+		{
+			auto input = make_input<T>(pattern, size);
+			auto target = make_shared<heap::sequence_heap<T>>();
+			return function<void()>([input, target]()
+				{
+					for (auto& value : *input)
+					{
+						target->insert(value);
+					}
+				});
+		} });
+	suite.push_back({ "sequence_heap", "remove", element, pattern, size, [pattern, size]()
+		{
+			auto input = make_input<T>(pattern, size);
+			auto target = make_shared<heap::sequence_heap<T>>();
+			for (auto& value : *input)
+			{
+				target->insert(value);
+			}
+			return function<void()>([target]()
+				{
+					while (!target->empty())
+					{
+						target->remove();
+					}
+				});
+		} });
+
+	suite.push_back({ "heap_wrapper", "build", element, pattern, size, [pattern, size]()
+		{
+			auto input = make_input<T>(pattern, size);
+			auto data = make_shared<heap::stable_storage<T>>(input->begin(), input->end());
+			return function<void()>([data]() { heap::heap_wrapper<T> built{ *data }; });
+		} });
+	suite.push_back({ "heap_wrapper", "remove", element, pattern, size, [pattern, size]()
+		{
+			auto input = make_input<T>(pattern, size);
+			auto state = make_shared<wrapper_state<T>>(*input);
+			return function<void()>([state]()
+				{
+					while (!state->wrapper.empty())
+					{
+						state->wrapper.remove();
+					}
+				});
+		} });
+
+	suite.push_back({ "priority_queue", "enqueue", element, pattern, size, [pattern, size]()
+		{
+			auto input = make_input<T>(pattern, size);
+			auto queue = make_shared<heap::priority_queue<T, int>>();
+			return function<void()>([input, queue]()
+				{
+					int value = 0;
+					for (auto& key : *input)
+					{
+						queue->enqueue(key, value++);
+					}
+				});
+		} });
+	suite.push_back({ "priority_queue", "dequeue", element, pattern, size, [pattern, size]()
+		{
+			auto input = make_input<T>(pattern, size);
+			auto queue = make_shared<heap::priority_queue<T, int>>();
+			int value = 0;
+			for (auto& key : *input)
+			{
+				queue->enqueue(key, value++);
+			}
+			return function<void()>([queue]()
+				{
+					while (!queue->empty())
+					{
+						queue->dequeue();
+					}
+				});
+		} });
+
+	suite.push_back({ "min_max_heap", "build", element, pattern, size, [pattern, size]()
+		{
+			auto input = make_input<T>(pattern, size);
+			auto data = make_shared<vector<T>>(*input);
+			return function<void()>([data]() { heap::min_max_heap<T> built{ *data }; });
+		} });
+	suite.push_back({ "min_max_heap", "pop_both", element, pattern, size, [pattern, size]()
+		{
+			auto input = make_input<T>(pattern, size);
+			auto state = make_shared<min_max_state<T>>(*input);
+			return function<void()>([state]()
+				{
+					auto& target = state->target;
+					while (!target.empty())
+					{
+						target.pop_min();
+						if (!target.empty())
+						{
+							target.pop_max();
+						}
+					}
+				});
+		} });
+
+	suite.push_back({ "heap_sort", "sort", element, pattern, size, [pattern, size]()
+		{
+			auto input = make_input<T>(pattern, size);
+			auto data = make_shared<vector<T>>(*input);
+			return function<void()>([data]() { heap::heap_sort<T>(*data); });
+		} });
+}
+
+//legacy::AVLTree does not free its nodes
+static shared_ptr<legacy::AVLTree> make_legacy_tree()
+{
+	return shared_ptr<legacy::AVLTree>(new legacy::AVLTree(), [](legacy::AVLTree* tree)
+		{
+			for (auto node : tree->traverse_inorder(tree->root))
+			{
+				delete node;
+			}
+			delete tree;
+		});
+}
+
+static shared_ptr<const vector<int>> sorted_unique(const vector<int>& input)
+{
+	auto sorted = make_shared<vector<int>>(input);
+	sort(sorted->begin(), sorted->end());
+	sorted->erase(unique(sorted->begin(), sorted->end()), sorted->end());
+	return sorted;
+}
+
+static void add_int_cases(vector<benchmark_case>& suite, const string& pattern, size_t size)
+{
+	suite.push_back({ "AVLTree", "insert", "int", pattern, size, [pattern, size]()
+		{
+			auto input = make_input<int>(pattern, size);
+			auto tree = make_shared<AVLTree<int>>();
+			return function<void()>([input, tree]()
+				{
+					for (auto value : *input)
+					{
+						tree->insert(value);
+					}
+				});
+		} });
+	suite.push_back({ "AVLTree", "search", "int", pattern, size, [pattern, size]()
+		{
+			auto input = make_input<int>(pattern, size);
+			auto tree = make_shared<AVLTree<int>>();
+			for (auto value : *input)
+			{
+				tree->insert(value);
+			}
+			return function<void()>([input, tree]()
+				{
+					long long found = 0;
+					for (auto value : *input)
+					{
+						found += tree->contains(value);
+					}
+					sink = found;
+				});
+		} });
+	suite.push_back({ "FrozenAVLTree_eytzinger", "search", "int", pattern, size, [pattern, size]()
+		{
+			auto input = make_input<int>(pattern, size);
+			auto sorted = sorted_unique(*input);
+			auto frozen = make_shared<FrozenAVLTree<int>>(FrozenAVLTree<int>::from_sorted(sorted->begin(), sorted->end()));
+			return function<void()>([input, frozen]()
+				{
+					long long found = 0;
+					for (auto value : *input)
+					{
+						found += frozen->contains(value);
+					}
+					sink = found;
+				});
+		} });
+	suite.push_back({ "FrozenAVLTree_blocks", "search", "int", pattern, size, [pattern, size]()
+		{
+			using blocks = FrozenAVLTree<int, void, less<int>, FrozenLayout::blocks>;
+			auto input = make_input<int>(pattern, size);
+			auto sorted = sorted_unique(*input);
+			auto frozen = make_shared<blocks>(blocks::from_sorted(sorted->begin(), sorted->end()));
+			return function<void()>([input, frozen]()
+				{
+					long long found = 0;
+					for (auto value : *input)
+					{
+						found += frozen->contains(value);
+					}
+					sink = found;
+				});
+		} });
+	suite.push_back({ "sorted_vector", "binary_search", "int", pattern, size, [pattern, size]()
+		{
+			auto input = make_input<int>(pattern, size);
+			auto sorted = sorted_unique(*input);
+			return function<void()>([input, sorted]()
+				{
+					long long found = 0;
+					for (auto value : *input)
+					{
+						found += binary_search(sorted->begin(), sorted->end(), value);
+					}
+					sink = found;
+				});
+		} });
+	suite.push_back({ "AVLTree", "erase", "int", pattern, size, [pattern, size]()
+		{
+			auto input = make_input<int>(pattern, size);
+			auto tree = make_shared<AVLTree<int>>();
+			for (auto value : *input)
+			{
+				tree->insert(value);
+			}
+			return function<void()>([input, tree]()
+				{
+					for (auto value : *input)
+					{
+						tree->erase(value);
+					}
+				});
+		} });
+	suite.push_back({ "AVLTree", "iterate", "int", pattern, size, [pattern, size]()
+		{
+			auto input = make_input<int>(pattern, size);
+			auto tree = make_shared<AVLTree<int>>();
+			for (auto value : *input)
+			{
+				tree->insert(value);
+			}
+			return function<void()>([tree]()
+				{
+					long long total = 0;
+					for (auto node : *tree)
+					{
+						total += node->key;
+					}
+					sink = total;
+				});
+		} });
+	suite.push_back({ "AVLTree", "from_sorted", "int", pattern, size, [pattern, size]()
+		{
+			auto sorted = sorted_unique(*make_input<int>(pattern, size));
+			return function<void()>([sorted]()
+				{
+					auto tree = AVLTree<int>::from_sorted(sorted->begin(), sorted->end());
+					sink = static_cast<long long>(tree.size());
+				});
+		} });
+	suite.push_back({ "AVLTree", "union", "int", pattern, size, [pattern, size]()
+		{
+			auto first = sorted_unique(*make_input<int>(pattern, size));
+			auto second = sorted_unique(*make_input<int>(pattern, size, 2));
+			auto trees = make_shared<pair<AVLTree<int>, AVLTree<int>>>(AVLTree<int>::from_sorted(first->begin(), first->end()),
+				AVLTree<int>::from_sorted(second->begin(), second->end()));
+			return function<void()>([trees]()
+				{
+					sink = static_cast<long long>(AVLTree<int>::set_union(trees->first, trees->second).size());
+				});
+		} });
+	suite.push_back({ "AVLTree", "union_by_insert", "int", pattern, size, [pattern, size]()
+		{
+			auto first = sorted_unique(*make_input<int>(pattern, size));
+			auto second = make_input<int>(pattern, size, 2);
+			auto tree = make_shared<AVLTree<int>>(AVLTree<int>::from_sorted(first->begin(), first->end()));
+			return function<void()>([tree, second]()
+				{
+					for (auto value : *second)
+					{
+						tree->insert(value);
+					}
+				});
+		} });
+	suite.push_back({ "sorted_vector", "set_union", "int", pattern, size, [pattern, size]()
+		{
+			auto first = sorted_unique(*make_input<int>(pattern, size));
+			auto second = sorted_unique(*make_input<int>(pattern, size, 2));
+			return function<void()>([first, second]()
+				{
+					vector<int> united;
+					united.reserve(first->size() + second->size());
+					set_union(first->begin(), first->end(), second->begin(), second->end(), back_inserter(united));
+					sink = static_cast<long long>(united.size());
+				});
+		} });
+	//legacy::AVLTree::delete_node crashes on random trees, so std::set is the reference for erase
+	suite.push_back({ "std_set", "erase", "int", pattern, size, [pattern, size]()
+		{
+			auto input = make_input<int>(pattern, size);
+			auto tree = make_shared<set<int>>(input->begin(), input->end());
+			return function<void()>([input, tree]()
+				{
+					for (auto value : *input)
+					{
+						tree->erase(value);
+					}
+				});
+		} });
+	suite.push_back({ "legacy_AVLTree", "insert", "int", pattern, size, [pattern, size]()
+		{
+			auto input = make_input<int>(pattern, size);
+			auto tree = make_legacy_tree();
+			return function<void()>([input, tree]()
+				{
+					muted_output muted;
+					for (auto value : *input)
+					{
+						tree->insert(value);
+					}
+				});
+		} });
+	suite.push_back({ "legacy_AVLTree", "search", "int", pattern, size, [pattern, size]()
+		{
+			auto input = make_input<int>(pattern, size);
+			auto tree = make_legacy_tree();
+			{
+				muted_output muted;
+				for (auto value : *input)
+				{
+					tree->insert(value);
+				}
+			}
+			return function<void()>([input, tree]()
+				{
+					long long found = 0;
+					for (auto value : *input)
+					{
+						found += tree->search(value) != nullptr;
+					}
+					sink = found;
+				});
+		} });
+	suite.push_back({ "legacy_AVLTree", "iterate", "int", pattern, size, [pattern, size]()
+		{
+			auto input = make_input<int>(pattern, size);
+			auto tree = make_legacy_tree();
+			{
+				muted_output muted;
+				for (auto value : *input)
+				{
+					tree->insert(value);
+				}
+			}
+			return function<void()>([tree]()
+				{
+					long long total = 0;
+					for (auto node : *tree)
+					{
+						total += node->value;
+					}
+					sink = total;
+				});
+		} });
+
+	suite.push_back({ "three_way_disjoint", "check", "int", pattern, size, [pattern, size]()
+		{
+			auto input = make_input<int>(pattern, size);
+			auto second = make_input<int>(pattern, size, 2);
+			auto third = make_input<int>(pattern, size, 3);
+			return function<void()>([input, second, third]() { sink = three_way_disjoint(*input, *second, *third); });
+		} });
+
+	suite.push_back({ "gcd", "mod_quotient", "int", pattern, size, [pattern, size]()
+		{
+			auto input = make_input<int>(pattern, size);
+			return function<void()>([input]()
+				{
+					long long total = 0;
+					for (auto value : *input)
+					{
+						total += mod_quotient(value % 1000000000 + 1, 1000000007);
+					}
+					sink = total;
+				});
+		} });
+}
+
+//every structure for every element type, access pattern and size
+vector<benchmark_case> make_suite(const vector<size_t>& sizes)
+{
+	vector<benchmark_case> suite;
+	for (auto size : sizes)
+	{
+		for (auto& pattern : patterns)
+		{
+			add_heap_family_cases<int>(suite, pattern, size);
+			add_heap_family_cases<pair<int, int>>(suite, pattern, size);
+			add_heap_family_cases<string>(suite, pattern, size);
+			add_int_cases(suite, pattern, size);
+		}
+	}
+	return suite;
+}
\ No newline at end of file
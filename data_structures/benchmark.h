@@ -0,0 +1,552 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace benchmark
+{
+	//counts the last-level cache misses of the calling thread through perf_event_open. Elsewhere, or where the kernel
+	//refuses the counter (perf_event_paranoid, containers, virtual machines without a PMU), available() is false
+	class cache_miss_counter
+	{
+	private:
+#ifdef __linux__
+		int descriptor = -1;
+#endif
+
+	public:
+		cache_miss_counter()
+		{
+#ifdef __linux__
+			perf_event_attr attributes{};
+			attributes.size = sizeof(attributes);
+			attributes.type = PERF_TYPE_HARDWARE;
+			attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+			attributes.disabled = 1;
+			attributes.exclude_kernel = 1;
+			attributes.exclude_hv = 1;
+			descriptor = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+#endif
+		}
+		cache_miss_counter(const cache_miss_counter&) = delete;
+		cache_miss_counter& operator=(const cache_miss_counter&) = delete;
+		~cache_miss_counter()
+		{
+#ifdef __linux__
+			if (descriptor >= 0)
+			{
+				close(descriptor);
+			}
+#endif
+		}
+
+		bool available() const
+		{
+#ifdef __linux__
+			return descriptor >= 0;
+#else
+			return false;
+#endif
+		}
+		void start()
+		{
+#ifdef __linux__
+			if (descriptor >= 0)
+			{
+				ioctl(descriptor, PERF_EVENT_IOC_RESET, 0);
+				ioctl(descriptor, PERF_EVENT_IOC_ENABLE, 0);
+			}
+#endif
+		}
+		//the misses since start, 0 if the counter is not available
+		unsigned long long stop()
+		{
+			unsigned long long misses = 0;
+#ifdef __linux__
+			if (descriptor >= 0)
+			{
+				ioctl(descriptor, PERF_EVENT_IOC_DISABLE, 0);
+				if (read(descriptor, &misses, sizeof(misses)) != static_cast<ssize_t>(sizeof(misses)))
+				{
+					misses = 0;
+				}
+			}
+#endif
+			return misses;
+		}
+	};
+
+	//discards what is written to std::cout while it lives, e.g. the rotations legacy::AVLTree reports
+	struct muted_output
+	{
+		std::streambuf* original = std::cout.rdbuf(nullptr);
+
+		muted_output() = default;
+		muted_output(const muted_output&) = delete;
+		muted_output& operator=(const muted_output&) = delete;
+		~muted_output()
+		{
+			std::cout.rdbuf(original);
+		}
+	};
+
+	//one measured configuration. prepare builds the input outside of the measurement and returns the timed body;
+	//it is called again before every repetition, so bodies may consume their input
+	struct benchmark_case
+	{
+		std::string structure;
+		std::string operation;
+		std::string element;
+		std::string pattern;
+		size_t size;
+		std::function<std::function<void()>()> prepare;
+
+		std::string name() const
+		{
+			return structure + "/" + operation + "/" + element + "/" + pattern + "/" + std::to_string(size);
+		}
+	};
+
+	//durations of one case in nanoseconds
+	struct statistics
+	{
+		double min, mean, median, p90, p99, max;
+	};
+
+	struct result
+	{
+		benchmark_case target;
+		std::vector<double> samples;
+		statistics summary;
+		//per repetition, empty if the cache_miss_counter is not available
+		std::vector<double> cache_misses;
+		//median of the same case in the baseline, 0 if the baseline does not have it
+		double baseline_median = 0;
+	};
+
+	//linear interpolation between the closest ranks of sorted samples
+	inline double percentile(const std::vector<double>& sorted, double fraction)
+	{
+		if (sorted.empty())
+		{
+			throw std::invalid_argument{ "The samples are empty" };
+		}
+
+		auto position = fraction * (sorted.size() - 1);
+		auto lower = static_cast<size_t>(position);
+		auto upper = std::min(lower + 1, sorted.size() - 1);
+		return sorted[lower] + (sorted[upper] - sorted[lower]) * (position - lower);
+	}
+
+	inline statistics summarize(std::vector<double> samples)
+	{
+		std::sort(samples.begin(), samples.end());
+
+		double total = 0;
+		for (auto sample : samples)
+		{
+			total += sample;
+		}
+
+		return { samples.front(), total / samples.size(), percentile(samples, 0.5),
+			percentile(samples, 0.9), percentile(samples, 0.99), samples.back() };
+	}
+
+	inline result run(const benchmark_case& target, size_t repetitions, size_t warmup)
+	{
+		if (repetitions == 0)
+		{
+			throw std::invalid_argument{ "At least one repetition is required" };
+		}
+
+		result measured{ target, {}, {}, {} };
+		cache_miss_counter counter;
+		for (size_t repetition = 0; repetition < warmup + repetitions; repetition++)
+		{
+			auto body = target.prepare();
+
+			counter.start();
+			auto start_point = std::chrono::steady_clock::now();
+			body();
+			auto elapsed = std::chrono::steady_clock::now() - start_point;
+			auto misses = counter.stop();
+
+			if (repetition >= warmup)
+			{
+				measured.samples.push_back(static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+				if (counter.available())
+				{
+					measured.cache_misses.push_back(static_cast<double>(misses));
+				}
+			}
+		}
+
+		measured.summary = summarize(measured.samples);
+		return measured;
+	}
+
+	//the subset of JSON the reports are written in: objects, arrays, strings, numbers, booleans and null
+	struct json_value
+	{
+		enum class kind { null, boolean, number, string, array, object };
+
+		kind type = kind::null;
+		bool flag = false;
+		double number = 0;
+		std::string text;
+		std::vector<json_value> items;
+		std::map<std::string, json_value> members;
+
+		const json_value* find(const std::string& key) const
+		{
+			auto found = members.find(key);
+			return found == members.end() ? nullptr : &found->second;
+		}
+	};
+
+	class json_parser
+	{
+	private:
+		const std::string& source;
+		size_t position = 0;
+
+		[[noreturn]] void fail(const std::string& message) const
+		{
+			throw std::runtime_error{ "Invalid JSON at offset " + std::to_string(position) + ": " + message };
+		}
+		void skip_whitespace()
+		{
+			while (position < source.size() && (source[position] == ' ' || source[position] == '\t' ||
+				source[position] == '\n' || source[position] == '\r'))
+			{
+				position++;
+			}
+		}
+		char peek()
+		{
+			skip_whitespace();
+			if (position == source.size())
+			{
+				fail("unexpected end");
+			}
+			return source[position];
+		}
+		void expect(char symbol)
+		{
+			if (peek() != symbol)
+			{
+				fail(std::string{ "expected '" } + symbol + "'");
+			}
+			position++;
+		}
+		bool consume(const char* word)
+		{
+			auto length = std::char_traits<char>::length(word);
+			if (source.compare(position, length, word) != 0)
+			{
+				return false;
+			}
+			position += length;
+			return true;
+		}
+
+		std::string parse_string()
+		{
+			expect('"');
+			std::string text;
+			while (position < source.size() && source[position] != '"')
+			{
+				auto symbol = source[position++];
+				if (symbol == '\\')
+				{
+					if (position == source.size())
+					{
+						fail("unterminated escape");
+					}
+					auto escaped = source[position++];
+					switch (escaped)
+					{
+					case 'n': text += '\n'; break;
+					case 't': text += '\t'; break;
+					case 'r': text += '\r'; break;
+					case 'b': text += '\b'; break;
+					case 'f': text += '\f'; break;
+					case 'u':
+					{
+						//only the control characters written by write_string are expected here
+						if (position + 4 > source.size())
+						{
+							fail("truncated \\u escape");
+						}
+						text += static_cast<char>(std::stoi(source.substr(position, 4), nullptr, 16));
+						position += 4;
+						break;
+					}
+					default: text += escaped; break;
+					}
+				}
+				else
+				{
+					text += symbol;
+				}
+			}
+			if (position == source.size())
+			{
+				fail("unterminated string");
+			}
+			position++;
+			return text;
+		}
+		json_value parse_value()
+		{
+			json_value value;
+			auto symbol = peek();
+
+			if (symbol == '{')
+			{
+				value.type = json_value::kind::object;
+				position++;
+				if (peek() == '}')
+				{
+					position++;
+					return value;
+				}
+				while (true)
+				{
+					auto key = parse_string();
+					expect(':');
+					value.members[key] = parse_value();
+					if (peek() == ',')
+					{
+						position++;
+						continue;
+					}
+					expect('}');
+					return value;
+				}
+			}
+			if (symbol == '[')
+			{
+				value.type = json_value::kind::array;
+				position++;
+				if (peek() == ']')
+				{
+					position++;
+					return value;
+				}
+				while (true)
+				{
+					value.items.push_back(parse_value());
+					if (peek() == ',')
+					{
+						position++;
+						continue;
+					}
+					expect(']');
+					return value;
+				}
+			}
+			if (symbol == '"')
+			{
+				value.type = json_value::kind::string;
+				value.text = parse_string();
+				return value;
+			}
+			if (consume("true"))
+			{
+				value.type = json_value::kind::boolean;
+				value.flag = true;
+				return value;
+			}
+			if (consume("false"))
+			{
+				value.type = json_value::kind::boolean;
+				return value;
+			}
+			if (consume("null"))
+			{
+				return value;
+			}
+
+			size_t parsed = 0;
+			try
+			{
+				value.number = std::stod(source.substr(position, 32), &parsed);
+			}
+			catch (const std::logic_error&)
+			{
+				fail("unexpected character");
+			}
+			value.type = json_value::kind::number;
+			position += parsed;
+			return value;
+		}
+
+	public:
+		explicit json_parser(const std::string& source)
+			: source(source)
+		{
+
+		}
+
+		json_value parse()
+		{
+			auto value = parse_value();
+			skip_whitespace();
+			if (position != source.size())
+			{
+				fail("trailing characters");
+			}
+			return value;
+		}
+	};
+
+	inline void write_string(std::ostream& out, const std::string& text)
+	{
+		out << '"';
+		for (auto symbol : text)
+		{
+			if (symbol == '"' || symbol == '\\')
+			{
+				out << '\\' << symbol;
+			}
+			else if (static_cast<unsigned char>(symbol) < 0x20)
+			{
+				char escaped[8];
+				std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(symbol));
+				out << escaped;
+			}
+			else
+			{
+				out << symbol;
+			}
+		}
+		out << '"';
+	}
+
+	//writes the results as {"context": {...}, "benchmarks": [...]}; change is current / baseline median - 1
+	inline void write_json(std::ostream& out, const std::vector<result>& results, const std::vector<std::pair<std::string, std::string>>& context)
+	{
+		auto old_precision = out.precision(12);
+
+		out << "{\n  \"context\": {";
+		for (size_t index = 0; index < context.size(); index++)
+		{
+			out << (index == 0 ? "\n    " : ",\n    ");
+			write_string(out, context[index].first);
+			out << ": ";
+			write_string(out, context[index].second);
+		}
+		out << "\n  },\n  \"benchmarks\": [";
+
+		for (size_t index = 0; index < results.size(); index++)
+		{
+			auto& measured = results[index];
+			auto& target = measured.target;
+			auto& summary = measured.summary;
+
+			out << (index == 0 ? "\n    {" : ",\n    {");
+			out << "\"name\": ";
+			write_string(out, target.name());
+			out << ", \"structure\": ";
+			write_string(out, target.structure);
+			out << ", \"operation\": ";
+			write_string(out, target.operation);
+			out << ", \"element\": ";
+			write_string(out, target.element);
+			out << ", \"pattern\": ";
+			write_string(out, target.pattern);
+			out << ", \"size\": " << target.size << ", \"repetitions\": " << measured.samples.size();
+			out << ",\n      \"ns\": {\"min\": " << summary.min << ", \"mean\": " << summary.mean << ", \"median\": " << summary.median <<
+				", \"p90\": " << summary.p90 << ", \"p99\": " << summary.p99 << ", \"max\": " << summary.max << "}";
+			out << ", \"ns_per_element\": " << summary.median / std::max<size_t>(target.size, 1);
+			if (!measured.cache_misses.empty())
+			{
+				out << ", \"cache_misses\": " << summarize(measured.cache_misses).median;
+			}
+			if (measured.baseline_median > 0)
+			{
+				out << ",\n      \"baseline_median\": " << measured.baseline_median <<
+					", \"change\": " << summary.median / measured.baseline_median - 1;
+			}
+			out << "}";
+		}
+		out << "\n  ]\n}\n";
+
+		out.precision(old_precision);
+	}
+
+	//medians by case name from a report written by write_json
+	inline std::map<std::string, double> read_baseline(const std::string& path)
+	{
+		std::ifstream file(path);
+		if (!file)
+		{
+			throw std::runtime_error{ "Cannot open " + path };
+		}
+		std::stringstream contents;
+		contents << file.rdbuf();
+		auto text = contents.str();
+
+		auto report = json_parser(text).parse();
+		auto benchmarks = report.find("benchmarks");
+		if (benchmarks == nullptr || benchmarks->type != json_value::kind::array)
+		{
+			throw std::runtime_error{ path + " is not a benchmark report" };
+		}
+
+		std::map<std::string, double> medians;
+		for (auto& entry : benchmarks->items)
+		{
+			auto name = entry.find("name");
+			auto ns = entry.find("ns");
+			auto median = ns == nullptr ? nullptr : ns->find("median");
+			if (name != nullptr && median != nullptr)
+			{
+				medians[name->text] = median->number;
+			}
+		}
+		return medians;
+	}
+
+	//attaches the baseline medians to results and returns the cases that got slower by more than threshold, e.g. 0.1 for 10%
+	inline std::vector<const result*> compare(std::vector<result>& results, const std::map<std::string, double>& baseline, double threshold)
+	{
+		std::vector<const result*> regressions;
+		for (auto& measured : results)
+		{
+			auto found = baseline.find(measured.target.name());
+			if (found == baseline.end() || found->second <= 0)
+			{
+				continue;
+			}
+
+			measured.baseline_median = found->second;
+			if (measured.summary.median > found->second * (1 + threshold))
+			{
+				regressions.push_back(&measured);
+			}
+		}
+		return regressions;
+	}
+}
\ No newline at end of file
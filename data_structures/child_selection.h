@@ -0,0 +1,277 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define HEAP_SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace heap
+{
+	//finds the preceding child among count contiguous siblings, the first one on ties.
+	//interface uses it in every bubble_down step
+	template<typename T, typename comp, size_t arity>
+	struct child_selector
+	{
+		static constexpr comp precede = comp{};
+
+		static size_t select(const T* children, size_t count)
+		{
+			size_t best = 0;
+			for (size_t child = 1; child < count; child++)
+			{
+				if (precede(children[child], children[best]))
+				{
+					best = child;
+				}
+			}
+			return best;
+		}
+	};
+
+#ifdef HEAP_SIMD_X86
+#if defined(__GNUC__) || defined(__clang__)
+#define HEAP_TARGET_AVX2 __attribute__((target("avx2")))
+#define HEAP_TARGET_SSE41 __attribute__((target("sse4.1")))
+#else
+#define HEAP_TARGET_AVX2
+#define HEAP_TARGET_SSE41
+#endif
+
+	namespace simd
+	{
+		inline unsigned first_set(unsigned mask)
+		{
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanForward(&index, mask);
+			return index;
+#else
+			return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+		}
+
+		inline bool has_avx2()
+		{
+#ifdef _MSC_VER
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] < 7)
+			{
+				return false;
+			}
+			__cpuid(info, 1);
+			//the OS has to save the ymm registers (OSXSAVE and XCR0 bits 1-2)
+			if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6)
+			{
+				return false;
+			}
+			__cpuidex(info, 7, 0);
+			return (info[1] & (1 << 5)) != 0;
+#else
+			return __builtin_cpu_supports("avx2");
+#endif
+		}
+		inline bool has_sse41()
+		{
+#ifdef _MSC_VER
+			int info[4];
+			__cpuid(info, 1);
+			return (info[2] & (1 << 19)) != 0;
+#else
+			return __builtin_cpu_supports("sse4.1");
+#endif
+		}
+
+		//the scalar selection of count siblings, the same as child_selector's
+		template<typename T, bool greatest>
+		size_t scan(const T* children, size_t count)
+		{
+			size_t best = 0;
+			for (size_t child = 1; child < count; child++)
+			{
+				if (greatest ? children[best] < children[child] : children[child] < children[best])
+				{
+					best = child;
+				}
+			}
+			return best;
+		}
+
+		//each kernel returns the index of the first minimum (maximum if greatest) of its full sibling group.
+		//The extreme value is broadcast to every lane, compared back against the children and the first
+		//matching lane is taken from the mask, so there is no data-dependent branch
+		template<bool greatest>
+		HEAP_TARGET_AVX2 size_t select8_avx2(const int* children)
+		{
+			auto values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(children));
+			auto extreme = greatest ? _mm256_max_epi32(values, _mm256_permute2x128_si256(values, values, 1))
+				: _mm256_min_epi32(values, _mm256_permute2x128_si256(values, values, 1));
+			auto shuffled = _mm256_shuffle_epi32(extreme, _MM_SHUFFLE(1, 0, 3, 2));
+			extreme = greatest ? _mm256_max_epi32(extreme, shuffled) : _mm256_min_epi32(extreme, shuffled);
+			shuffled = _mm256_shuffle_epi32(extreme, _MM_SHUFFLE(2, 3, 0, 1));
+			extreme = greatest ? _mm256_max_epi32(extreme, shuffled) : _mm256_min_epi32(extreme, shuffled);
+
+			auto mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(values, extreme)));
+			return first_set(static_cast<unsigned>(mask));
+		}
+		template<bool greatest>
+		HEAP_TARGET_AVX2 size_t select8_avx2(const float* children)
+		{
+			auto values = _mm256_loadu_ps(children);
+			auto extreme = greatest ? _mm256_max_ps(values, _mm256_permute2f128_ps(values, values, 1))
+				: _mm256_min_ps(values, _mm256_permute2f128_ps(values, values, 1));
+			auto shuffled = _mm256_shuffle_ps(extreme, extreme, _MM_SHUFFLE(1, 0, 3, 2));
+			extreme = greatest ? _mm256_max_ps(extreme, shuffled) : _mm256_min_ps(extreme, shuffled);
+			shuffled = _mm256_shuffle_ps(extreme, extreme, _MM_SHUFFLE(2, 3, 0, 1));
+			extreme = greatest ? _mm256_max_ps(extreme, shuffled) : _mm256_min_ps(extreme, shuffled);
+
+			//min and max do not order a NaN, which may leave no lane equal to the extreme
+			if (_mm256_movemask_ps(_mm256_cmp_ps(values, values, _CMP_UNORD_Q)) != 0)
+			{
+				return scan<float, greatest>(children, 8);
+			}
+			auto mask = _mm256_movemask_ps(_mm256_cmp_ps(values, extreme, _CMP_EQ_OQ));
+			return first_set(static_cast<unsigned>(mask));
+		}
+		template<bool greatest>
+		HEAP_TARGET_SSE41 __m128i extreme4_sse41(__m128i values)
+		{
+			auto shuffled = _mm_shuffle_epi32(values, _MM_SHUFFLE(1, 0, 3, 2));
+			auto extreme = greatest ? _mm_max_epi32(values, shuffled) : _mm_min_epi32(values, shuffled);
+			shuffled = _mm_shuffle_epi32(extreme, _MM_SHUFFLE(2, 3, 0, 1));
+			return greatest ? _mm_max_epi32(extreme, shuffled) : _mm_min_epi32(extreme, shuffled);
+		}
+		template<bool greatest>
+		HEAP_TARGET_SSE41 __m128 extreme4_sse41(__m128 values)
+		{
+			auto shuffled = _mm_shuffle_ps(values, values, _MM_SHUFFLE(1, 0, 3, 2));
+			auto extreme = greatest ? _mm_max_ps(values, shuffled) : _mm_min_ps(values, shuffled);
+			shuffled = _mm_shuffle_ps(extreme, extreme, _MM_SHUFFLE(2, 3, 0, 1));
+			return greatest ? _mm_max_ps(extreme, shuffled) : _mm_min_ps(extreme, shuffled);
+		}
+		template<bool greatest>
+		HEAP_TARGET_SSE41 size_t select4_sse41(const int* children)
+		{
+			auto values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(children));
+			auto extreme = extreme4_sse41<greatest>(values);
+			return first_set(static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(values, extreme)))));
+		}
+		template<bool greatest>
+		HEAP_TARGET_SSE41 size_t select4_sse41(const float* children)
+		{
+			auto values = _mm_loadu_ps(children);
+			if (_mm_movemask_ps(_mm_cmpunord_ps(values, values)) != 0)
+			{
+				return scan<float, greatest>(children, 4);
+			}
+			auto extreme = extreme4_sse41<greatest>(values);
+			return first_set(static_cast<unsigned>(_mm_movemask_ps(_mm_cmpeq_ps(values, extreme))));
+		}
+		template<bool greatest>
+		HEAP_TARGET_SSE41 size_t select8_sse41(const int* children)
+		{
+			auto low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(children));
+			auto high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(children + 4));
+			auto extreme = extreme4_sse41<greatest>(greatest ? _mm_max_epi32(low, high) : _mm_min_epi32(low, high));
+			auto mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(low, extreme))) |
+				(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(high, extreme))) << 4);
+			return first_set(static_cast<unsigned>(mask));
+		}
+		template<bool greatest>
+		HEAP_TARGET_SSE41 size_t select8_sse41(const float* children)
+		{
+			auto low = _mm_loadu_ps(children);
+			auto high = _mm_loadu_ps(children + 4);
+			if (_mm_movemask_ps(_mm_cmpunord_ps(low, high)) != 0)
+			{
+				return scan<float, greatest>(children, 8);
+			}
+			auto extreme = extreme4_sse41<greatest>(greatest ? _mm_max_ps(low, high) : _mm_min_ps(low, high));
+			auto mask = _mm_movemask_ps(_mm_cmpeq_ps(low, extreme)) | (_mm_movemask_ps(_mm_cmpeq_ps(high, extreme)) << 4);
+			return first_set(static_cast<unsigned>(mask));
+		}
+
+		template<typename T, bool greatest, size_t arity>
+		struct kernels
+		{
+			using kernel = size_t(*)(const T*);
+
+			static size_t scalar(const T* children)
+			{
+				return scan<T, greatest>(children, arity);
+			}
+			//picks the widest kernel the running CPU supports; nullptr if there is none for T and arity
+			static kernel avx2();
+			static kernel sse41();
+			static kernel dispatch()
+			{
+				if (avx2() != nullptr && has_avx2())
+				{
+					return avx2();
+				}
+				if (sse41() != nullptr && has_sse41())
+				{
+					return sse41();
+				}
+				return &scalar;
+			}
+		};
+
+		template<typename T, bool greatest, size_t arity>
+		typename kernels<T, greatest, arity>::kernel kernels<T, greatest, arity>::avx2()
+		{
+			return nullptr;
+		}
+		template<typename T, bool greatest, size_t arity>
+		typename kernels<T, greatest, arity>::kernel kernels<T, greatest, arity>::sse41()
+		{
+			return nullptr;
+		}
+
+		template<> inline kernels<int, false, 8>::kernel kernels<int, false, 8>::avx2() { return &select8_avx2<false>; }
+		template<> inline kernels<int, true, 8>::kernel kernels<int, true, 8>::avx2() { return &select8_avx2<true>; }
+		template<> inline kernels<float, false, 8>::kernel kernels<float, false, 8>::avx2() { return &select8_avx2<false>; }
+		template<> inline kernels<float, true, 8>::kernel kernels<float, true, 8>::avx2() { return &select8_avx2<true>; }
+
+		template<> inline kernels<int, false, 8>::kernel kernels<int, false, 8>::sse41() { return &select8_sse41<false>; }
+		template<> inline kernels<int, true, 8>::kernel kernels<int, true, 8>::sse41() { return &select8_sse41<true>; }
+		template<> inline kernels<float, false, 8>::kernel kernels<float, false, 8>::sse41() { return &select8_sse41<false>; }
+		template<> inline kernels<float, true, 8>::kernel kernels<float, true, 8>::sse41() { return &select8_sse41<true>; }
+		template<> inline kernels<int, false, 4>::kernel kernels<int, false, 4>::sse41() { return &select4_sse41<false>; }
+		template<> inline kernels<int, true, 4>::kernel kernels<int, true, 4>::sse41() { return &select4_sse41<true>; }
+		template<> inline kernels<float, false, 4>::kernel kernels<float, false, 4>::sse41() { return &select4_sse41<false>; }
+		template<> inline kernels<float, true, 4>::kernel kernels<float, true, 4>::sse41() { return &select4_sse41<true>; }
+
+		//full sibling groups go through the kernel chosen on first use, a partial last group is scanned
+		template<typename T, bool greatest, size_t arity>
+		struct dispatched_selector
+		{
+			static size_t select(const T* children, size_t count)
+			{
+				static const auto chosen = kernels<T, greatest, arity>::dispatch();
+
+				if (count == arity)
+				{
+					return chosen(children);
+				}
+				return scan<T, greatest>(children, count);
+			}
+		};
+	}
+
+	template<> struct child_selector<int, std::less<int>, 4> : simd::dispatched_selector<int, false, 4> {};
+	template<> struct child_selector<int, std::greater<int>, 4> : simd::dispatched_selector<int, true, 4> {};
+	template<> struct child_selector<int, std::less<int>, 8> : simd::dispatched_selector<int, false, 8> {};
+	template<> struct child_selector<int, std::greater<int>, 8> : simd::dispatched_selector<int, true, 8> {};
+	template<> struct child_selector<float, std::less<float>, 4> : simd::dispatched_selector<float, false, 4> {};
+	template<> struct child_selector<float, std::greater<float>, 4> : simd::dispatched_selector<float, true, 4> {};
+	template<> struct child_selector<float, std::less<float>, 8> : simd::dispatched_selector<float, false, 8> {};
+	template<> struct child_selector<float, std::greater<float>, 8> : simd::dispatched_selector<float, true, 8> {};
+#endif
+}
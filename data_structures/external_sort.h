@@ -0,0 +1,371 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "heap.h"
+
+namespace heap
+{
+	struct external_sort_stats
+	{
+		size_t runs;
+		//passes over the data, run formation included
+		size_t passes;
+		unsigned long long bytes;
+	};
+
+	//one thread that reads ahead for every reader of a sort, block requests are served in order
+	class read_ahead_worker
+	{
+	private:
+		std::mutex lock;
+		std::condition_variable wake;
+		std::deque<std::packaged_task<size_t()>> tasks;
+		bool stopping = false;
+		std::thread worker;
+
+		void run()
+		{
+			while (true)
+			{
+				std::packaged_task<size_t()> task;
+				{
+					std::unique_lock<std::mutex> hold(lock);
+					wake.wait(hold, [this]() { return stopping || !tasks.empty(); });
+					if (tasks.empty())
+					{
+						return;
+					}
+					task = std::move(tasks.front());
+					tasks.pop_front();
+				}
+				task();
+			}
+		}
+
+	public:
+		read_ahead_worker() : worker([this]() { run(); }) {}
+		read_ahead_worker(const read_ahead_worker&) = delete;
+		read_ahead_worker& operator=(const read_ahead_worker&) = delete;
+		//the requests still queued are served before the thread ends
+		~read_ahead_worker()
+		{
+			{
+				std::lock_guard<std::mutex> hold(lock);
+				stopping = true;
+			}
+			wake.notify_one();
+			worker.join();
+		}
+
+		template<typename F>
+		std::future<size_t> submit(F&& read)
+		{
+			std::packaged_task<size_t()> task(std::forward<F>(read));
+			auto result = task.get_future();
+			{
+				std::lock_guard<std::mutex> hold(lock);
+				tasks.push_back(std::move(task));
+			}
+			wake.notify_one();
+			return result;
+		}
+	};
+
+	//reads the elements of a run file block by block; the worker reads the next block while the current
+	//one is consumed
+	template<typename T>
+	class run_reader
+	{
+	private:
+		std::FILE* file;
+		read_ahead_worker& worker;
+		std::vector<T> current, next;
+		size_t position = 0, available = 0;
+		std::future<size_t> pending;
+		bool exhausted = false;
+
+		void request()
+		{
+			pending = worker.submit([this]()
+				{
+					return std::fread(next.data(), sizeof(T), next.size(), file);
+				});
+		}
+
+	public:
+		run_reader(const std::string& path, size_t block, read_ahead_worker& worker)
+			: file(std::fopen(path.c_str(), "rb")), worker(worker), current(block), next(block)
+		{
+			if (file == nullptr)
+			{
+				throw std::runtime_error{ "Cannot open " + path };
+			}
+			request();
+		}
+		run_reader(const run_reader&) = delete;
+		run_reader& operator=(const run_reader&) = delete;
+		~run_reader()
+		{
+			if (pending.valid())
+			{
+				pending.wait();
+			}
+			std::fclose(file);
+		}
+
+		//the next element of the run, nullptr at its end; valid until the following call
+		const T* next_element()
+		{
+			if (position == available)
+			{
+				if (exhausted)
+				{
+					return nullptr;
+				}
+
+				available = pending.get();
+				position = 0;
+				if (available == 0)
+				{
+					exhausted = true;
+					return nullptr;
+				}
+
+				current.swap(next);
+				request();
+			}
+
+			return &current[position++];
+		}
+	};
+
+	template<typename T>
+	class run_writer
+	{
+	private:
+		std::FILE* file;
+		std::vector<T> buffer;
+		std::string path;
+
+	public:
+		run_writer(const std::string& path, size_t block)
+			: file(std::fopen(path.c_str(), "wb")), path(path)
+		{
+			if (file == nullptr)
+			{
+				throw std::runtime_error{ "Cannot create " + path };
+			}
+			buffer.reserve(block);
+		}
+		run_writer(const run_writer&) = delete;
+		run_writer& operator=(const run_writer&) = delete;
+		//a writer destroyed without flush still writes its buffered tail, but only flush reports errors
+		~run_writer()
+		{
+			if (!buffer.empty())
+			{
+				std::fwrite(buffer.data(), sizeof(T), buffer.size(), file);
+			}
+			std::fclose(file);
+		}
+
+		void write(const T& value)
+		{
+			buffer.push_back(value);
+			if (buffer.size() == buffer.capacity())
+			{
+				flush();
+			}
+		}
+		void write(const T* first, size_t count)
+		{
+			flush();
+			if (std::fwrite(first, sizeof(T), count, file) != count)
+			{
+				throw std::runtime_error{ "Cannot write " + path };
+			}
+		}
+		void flush()
+		{
+			if (std::fwrite(buffer.data(), sizeof(T), buffer.size(), file) != buffer.size())
+			{
+				throw std::runtime_error{ "Cannot write " + path };
+			}
+			buffer.clear();
+		}
+	};
+
+	//run files of an external sort; the ones still listed are removed with it, also when the sort throws
+	struct run_files
+	{
+		std::vector<std::string> paths;
+
+		run_files() = default;
+		run_files(const run_files&) = delete;
+		run_files& operator=(const run_files&) = delete;
+		~run_files()
+		{
+			for (auto& path : paths)
+			{
+				std::remove(path.c_str());
+			}
+		}
+	};
+
+	//orders the runs being merged by their current elements
+	template<typename T, typename comp>
+	struct external_sort_source_comp
+	{
+		static constexpr comp precede = comp{};
+		constexpr bool operator()(const std::pair<T, size_t>& left, const std::pair<T, size_t>& right) const
+		{
+			return precede(left.first, right.first);
+		}
+	};
+
+	//k-way merge of sorted readers into writer through a heap of their current elements:
+	//each written element costs one bubble_down
+	template<typename T, typename comp, typename reader>
+	void merge_runs(std::vector<reader*>& readers, run_writer<T>& writer)
+	{
+		using source = std::pair<T, size_t>;
+		using tournament = interface<source, external_sort_source_comp<T, comp>>;
+
+		std::vector<source> sources;
+		for (size_t index = 0; index < readers.size(); index++)
+		{
+			if (auto first = readers[index]->next_element())
+			{
+				sources.emplace_back(*first, index);
+			}
+		}
+		tournament::make_valid(sources);
+
+		while (!sources.empty())
+		{
+			writer.write(sources[0].first);
+
+			if (auto next = readers[sources[0].second]->next_element())
+			{
+				sources[0].first = *next;
+				tournament::bubble_down(sources, sources.size());
+			}
+			else
+			{
+				tournament::remove(sources);
+			}
+		}
+		writer.flush();
+	}
+
+	//sorts the binary file input into output, smallest first in comp order, using about memory_budget
+	//bytes of RAM. Runs of memory_budget bytes are sorted and written next to output, then merged
+	//fan-in at a time until one is left
+	template<typename T, typename comp = std::less<T>>
+	external_sort_stats external_sort(const std::string& input, const std::string& output, size_t memory_budget)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Runs are stored as raw bytes");
+
+		//every run being merged holds two blocks: the one consumed and the one read ahead
+		auto block_bytes = std::min<size_t>(std::max<size_t>(memory_budget / 16, 4096), size_t{ 1 } << 20);
+		auto block = std::max<size_t>(block_bytes / sizeof(T), 1);
+		auto fan_in = std::max<size_t>(memory_budget / (2 * block_bytes), 3) - 1;
+		auto run_size = std::max<size_t>(memory_budget / sizeof(T), 1);
+		auto run_path = [&](size_t pass, size_t index)
+			{
+				return output + ".run" + std::to_string(pass) + "_" + std::to_string(index);
+			};
+
+		external_sort_stats stats{ 0, 1, 0 };
+		run_files runs;
+		read_ahead_worker worker;
+
+		{
+			std::unique_ptr<std::FILE, int(*)(std::FILE*)> input_file(std::fopen(input.c_str(), "rb"), std::fclose);
+			if (!input_file)
+			{
+				throw std::runtime_error{ "Cannot open " + input };
+			}
+
+			std::vector<T> buffer(run_size);
+			while (auto bytes = std::fread(buffer.data(), 1, run_size * sizeof(T), input_file.get()))
+			{
+				if (bytes % sizeof(T) != 0)
+				{
+					throw std::runtime_error{ input + " ends with a partial element" };
+				}
+				auto count = bytes / sizeof(T);
+
+				//run formation is compare-bound in memory, where std::sort beats heap_sort by about 3x
+				std::sort(buffer.begin(), buffer.begin() + count, comp{});
+
+				runs.paths.push_back(run_path(0, runs.paths.size()));
+				run_writer<T>(runs.paths.back(), block).write(buffer.data(), count);
+				stats.bytes += count * sizeof(T);
+			}
+		}
+		stats.runs = runs.paths.size();
+
+		if (runs.paths.empty())
+		{
+			run_writer<T>(output, block).flush();
+			return stats;
+		}
+
+		while (true)
+		{
+			auto last_pass = runs.paths.size() <= fan_in;
+			run_files merged;
+
+			for (size_t first = 0; first < runs.paths.size(); first += fan_in)
+			{
+				auto last = std::min(first + fan_in, runs.paths.size());
+				if (!last_pass)
+				{
+					merged.paths.push_back(run_path(stats.passes, merged.paths.size()));
+				}
+
+				std::vector<std::unique_ptr<run_reader<T>>> files;
+				std::vector<run_reader<T>*> readers;
+				for (auto index = first; index < last; index++)
+				{
+					files.emplace_back(new run_reader<T>(runs.paths[index], block, worker));
+					readers.push_back(files.back().get());
+				}
+
+				{
+					run_writer<T> writer(last_pass ? output : merged.paths.back(), block);
+					merge_runs<T, comp>(readers, writer);
+				}
+
+				files.clear();
+				for (auto index = first; index < last; index++)
+				{
+					std::remove(runs.paths[index].c_str());
+				}
+			}
+
+			stats.passes++;
+			runs.paths = std::move(merged.paths);
+			merged.paths.clear();
+			if (last_pass)
+			{
+				return stats;
+			}
+		}
+	}
+}
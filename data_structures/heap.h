@@ -3,53 +3,88 @@
 #include <algorithm>
 #include <list>
 #include <cassert>
+#include <cstdint>
+#include <functional>
 #include <iterator>
+#include <limits>
 #include <stdexcept>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include "child_selection.h"
+#include "stable_storage.h"
+
 namespace heap
 {
-	template<typename T, typename comp = std::less<T>>
+	//default position tracking policy of interface: nothing is recorded
+	struct untracked
+	{
+		template<typename T>
+		static void placed(const T&, size_t)
+		{
+
+		}
+	};
+
+	//arity is the number of children per node; all children of a node are stored contiguously,
+	//so with arity * sizeof(T) <= 64 a whole sibling group is read with one or two cache lines.
+	//tracker::placed(element, index) is called for every element the routines store at a new index,
+	//which lets callers keep a position index for addressable heaps.
+	//container may be any contiguous array with the operator[], size, empty, back, push_back and pop_back of std::vector
+	template<typename T, typename comp = std::less<T>, size_t arity = 2, typename tracker = untracked, typename container = std::vector<T>>
 	class interface
 	{
+		static_assert(arity >= 2, "A heap node must have at least two children");
+
 	private:
-		using container = std::vector<T>;
+		using selector = child_selector<T, comp, arity>;
 		static constexpr comp precede = comp{};
 
 	public:
 		static size_t parent_index(size_t index)
 		{
 			assert(index > 0);
-			return (index - 1) / 2;
+			return (index - 1) / arity;
 		}
+		//index of the first (leftmost) child
 		static size_t left_index(size_t index)
 		{
-			return 2 * index + 1;
+			return arity * index + 1;
 		}
+		//index of the last (rightmost) child
 		static size_t right_index(size_t index)
 		{
-			return 2 * index + 2;
+			return arity * index + arity;
 		}
 
+		static void place(container& data, size_t index, T&& value)
+		{
+			data[index] = std::move(value);
+			tracker::placed(data[index], index);
+		}
 		static void swap(container& data, size_t x, size_t y)
 		{
-			auto temp = data[x];
-			data[x] = data[y];
-			data[y] = temp;
+			using std::swap;
+			swap(data[x], data[y]);
+			tracker::placed(data[x], x);
+			tracker::placed(data[y], y);
 		}
 
+		//sifting moves a hole instead of swapping: every element on the path is moved once
 		static void bubble_up(container& data, size_t start)
 		{
 			size_t current = start;
+			auto value = std::move(data[current]);
 
 			//current>0 is equivalent to current being a child of some element
 			while (current > 0)
 			{
 				auto parent = parent_index(current);
 
-				if (precede(data[current], data[parent]))
+				if (precede(value, data[parent]))
 				{
-					swap(data, parent, current);
+					place(data, current, std::move(data[parent]));
 					current = parent;
 				}
 				else
@@ -57,58 +92,127 @@ namespace heap
 					break;
 				}
 			}
+
+			place(data, current, std::move(value));
 		}
 		static void bubble_down(container& data, size_t end)
 		{
-			auto current = size_t{};
+			bubble_down(data, 0, end);
+		}
+		//sifts data[start] down within the subtree rooted at start, considering only indices below end
+		static void bubble_down(container& data, size_t start, size_t end)
+		{
+			if (start >= end)
+			{
+				return;
+			}
+
+			auto current = start;
+			auto value = std::move(data[current]);
+
+			while (true)
+			{
+				auto left = left_index(current);
+
+				if (left >= end)
+				{
+					break;
+				}
+
+				auto last = std::min(right_index(current), end - 1);
+				auto best = left + selector::select(&data[left], last - left + 1);
+
+				if (precede(data[best], value))
+				{
+					place(data, current, std::move(data[best]));
+					current = best;
+				}
+				else
+				{
+					break;
+				}
+			}
+
+			place(data, current, std::move(value));
+		}
+
+		//Wegener's bottom-up sift: the hole descends to a leaf along the preceding children without
+		//comparing them against the sifted value, which is then bubbled up from there (not above start).
+		//A value taken from the bottom of the heap usually belongs near the bottom again, so this needs
+		//about half the comparisons of bubble_down
+		static void bubble_down_bottom_up(container& data, size_t start, size_t end)
+		{
+			if (start >= end)
+			{
+				return;
+			}
+
+			auto current = start;
+			auto value = std::move(data[current]);
 
 			while (true)
 			{
 				auto left = left_index(current);
-				auto right = right_index(current);
 
-				if (right < end)
+				if (left >= end)
 				{
-					if (precede(data[left], data[current]) && precede(data[left], data[right]))
-					{
-						swap(data, current, left);
-						current = left;
-					}
-					else if (precede(data[right], data[current]))
-					{
-						swap(data, current, right);
-						current = right;
-					}
-					else
-					{
-						break;
-					}
+					break;
 				}
-				else if (left < end && precede(data[left], data[current]))
+
+				auto last = std::min(right_index(current), end - 1);
+				auto best = left + selector::select(&data[left], last - left + 1);
+
+				place(data, current, std::move(data[best]));
+				current = best;
+			}
+
+			while (current > start)
+			{
+				auto parent = parent_index(current);
+
+				if (precede(value, data[parent]))
 				{
-					swap(data, current, left);
-					current = left;
+					place(data, current, std::move(data[parent]));
+					current = parent;
 				}
 				else
 				{
 					break;
 				}
 			}
+
+			place(data, current, std::move(value));
 		}
 
+		//Floyd's construction: sifting down every internal node from the last one to the root is O(n)
 		static void make_valid(container& data)
 		{
 			for (size_t index = 0; index < data.size(); index++)
 			{
-				bubble_up(data, index);
+				tracker::placed(data[index], index);
+			}
+
+			if (data.size() < 2)
+			{
+				return;
+			}
+
+			for (auto index = parent_index(data.size() - 1) + 1; index > 0; index--)
+			{
+				bubble_down(data, index - 1, data.size());
 			}
 		}
 		static void sort(container& data)
 		{
+			if (data.size() < 2)
+			{
+				return;
+			}
+
 			for (size_t end = data.size() - 1; end > 0; end--)
 			{
 				swap(data, 0, end);
-				bubble_down(data, end);
+				bubble_down_bottom_up(data, 0, end);
 			}
 		}
 
@@ -117,6 +221,17 @@ namespace heap
 			data.push_back(value);
 			bubble_up(data, data.size() - 1);
 		}
+		static void insert(container& data, T&& value)
+		{
+			data.push_back(std::move(value));
+			bubble_up(data, data.size() - 1);
+		}
+		template<typename... Args>
+		static void emplace(container& data, Args&&... args)
+		{
+			data.emplace_back(std::forward<Args>(args)...);
+			bubble_up(data, data.size() - 1);
+		}
 		static void replace_top(container& data, const T& value)
 		{
 			if (data.empty())
@@ -129,6 +244,52 @@ namespace heap
 				bubble_down(data, data.size());
 			}
 		}
+		static void replace_top(container& data, T&& value)
+		{
+			if (data.empty())
+			{
+				insert(data, std::move(value));
+			}
+			else
+			{
+				data[0] = std::move(value);
+				bubble_down(data, data.size());
+			}
+		}
+		//restores the heap property after the element at index changed its priority
+		static void update(container& data, size_t index)
+		{
+			if (index > 0 && precede(data[index], data[parent_index(index)]))
+			{
+				bubble_up(data, index);
+			}
+			else
+			{
+				bubble_down(data, index, data.size());
+			}
+		}
+		static T remove(container& data, size_t index)
+		{
+			if (index >= data.size())
+			{
+				throw std::out_of_range{ "The index is out of range" };
+			}
+
+			auto removed = std::move(data[index]);
+
+			if (index + 1 < data.size())
+			{
+				data[index] = std::move(data.back());
+				data.pop_back();
+				update(data, index);
+			}
+			else
+			{
+				data.pop_back();
+			}
+
+			return removed;
+		}
 		static T remove(container& data)
 		{
 			if (data.empty())
@@ -136,9 +297,12 @@ namespace heap
 				throw std::invalid_argument{ "The data is empty" };
 			}
 
-			auto root = data[0];
+			auto root = std::move(data[0]);
 
-			data[0] = data[data.size() - 1];
+			if (data.size() > 1)
+			{
+				data[0] = std::move(data.back());
+			}
 			data.pop_back();
 			bubble_down(data, data.size());
 
@@ -146,12 +310,12 @@ namespace heap
 		}
 	};
 
-	template<typename T, typename comp = std::less<T>>
+	template<typename T, typename comp = std::less<T>, size_t arity = 2, typename tracker = untracked>
 	class heap
 	{
 	private:
 		std::vector<T>& data;
-		using interface = interface<T, comp>;
+		using interface = ::heap::interface<T, comp, arity, tracker>;
 	public:
 		heap(std::vector<T>& data)
 			:data(data)
@@ -163,14 +327,35 @@ namespace heap
 		{
 			interface::insert(data, value);
 		}
+		void insert(T&& value)
+		{
+			interface::insert(data, std::move(value));
+		}
+		template<typename... Args>
+		void emplace(Args&&... args)
+		{
+			interface::emplace(data, std::forward<Args>(args)...);
+		}
 		void replace_top(const T& value)
 		{
 			interface::replace_top(data, value);
 		}
+		void replace_top(T&& value)
+		{
+			interface::replace_top(data, std::move(value));
+		}
 		T remove()
 		{
 			return interface::remove(data);
 		}
+		T remove(size_t index)
+		{
+			return interface::remove(data, index);
+		}
+		void update(size_t index)
+		{
+			interface::update(data, index);
+		}
 
 		bool empty()
 		{
@@ -178,38 +363,159 @@ namespace heap
 		}
 	};
 
-	template<typename T, typename comp = std::less<T>>
+	//prefix policy of heap_wrapper: slots hold only the reference
+	struct no_prefix
+	{
+
+	};
+
+	//prefix policy for lexicographically ordered sequences such as std::vector<long long>: caches the first item
+	template<typename Sequence>
+	struct front_prefix
+	{
+		using key_type = typename Sequence::value_type;
+		static key_type extract(const Sequence& value)
+		{
+			return value.empty() ? std::numeric_limits<key_type>::lowest() : value.front();
+		}
+	};
+
+	//prefix policy for std::string: caches the first 8 bytes big-endian, so integer order matches string order
+	struct string_prefix
+	{
+		using key_type = std::uint64_t;
+		static key_type extract(const std::string& value)
+		{
+			key_type key = 0;
+			for (size_t index = 0; index < sizeof(key_type); index++)
+			{
+				key <<= 8;
+				if (index < value.size())
+				{
+					key |= static_cast<unsigned char>(value[index]);
+				}
+			}
+			return key;
+		}
+	};
+
+	//heap slot of heap_wrapper: a reference to the element plus the cached prefix::extract(element).
+	//prefix must agree with comp: extract(a) < extract(b) has to imply that a precedes b.
+	//Only slots with equal prefixes dereference their elements to be compared
+	template<typename T, typename comp, typename prefix>
+	struct wrapper_element
+	{
+		static constexpr comp precede_element = comp{};
+
+		typename prefix::key_type key;
+		std::reference_wrapper<T> item;
+
+		wrapper_element(T& item)
+			: key(prefix::extract(item)), item(item)
+		{
+
+		}
+
+		T& get() const
+		{
+			return item.get();
+		}
+		static bool precede(const wrapper_element& left, const wrapper_element& right)
+		{
+			if (left.key < right.key)
+			{
+				return true;
+			}
+			if (right.key < left.key)
+			{
+				return false;
+			}
+			return precede_element(left.get(), right.get());
+		}
+	};
+
+	template<typename T, typename comp>
+	struct wrapper_element<T, comp, no_prefix>
+	{
+		static constexpr comp precede_element = comp{};
+
+		std::reference_wrapper<T> item;
+
+		wrapper_element(T& item)
+			: item(item)
+		{
+
+		}
+
+		T& get() const
+		{
+			return item.get();
+		}
+		static bool precede(const wrapper_element& left, const wrapper_element& right)
+		{
+			return precede_element(left.get(), right.get());
+		}
+	};
+
+	//heap of references into a caller-owned stable_storage: elements are never moved by the sift routines,
+	//and remove gives the slot of the removed element back to the storage
+	template<typename T, typename comp = std::less<T>, size_t arity = 2, typename tracker = untracked, typename prefix = no_prefix,
+		typename Allocator = std::allocator<T>>
 	class heap_wrapper
 	{
+	public:
+		using storage_type = stable_storage<T, Allocator>;
+
 	private:
-		using element_type = std::reference_wrapper<T>;
+		using element_type = wrapper_element<T, comp, prefix>;
 		struct comp_wrapper
 		{
-			static constexpr comp precede = comp{};
-			constexpr bool operator()(element_type left, element_type right) const
+			constexpr bool operator()(const element_type& left, const element_type& right) const
+			{
+				return element_type::precede(left, right);
+			}
+		};
+		struct tracker_wrapper
+		{
+			static void placed(const element_type& element, size_t index)
 			{
-				return precede(left.get(), right.get());
+				tracker::placed(element.get(), index);
 			}
 		};
-		std::list<T>& original_data;
+		storage_type& original_data;
 		std::vector<element_type> data;
-		using interface = interface<element_type, comp_wrapper>;
+		using interface = ::heap::interface<element_type, comp_wrapper, arity, tracker_wrapper>;
+
+		T take(const element_type& removed)
+		{
+			T result = std::move(removed.get());
+			original_data.erase(removed.get());
+			return result;
+		}
 	public:
-		heap_wrapper() = default;
-		heap_wrapper(std::list<T>& original_data)
+		heap_wrapper(storage_type& original_data)
 			:original_data(original_data)
 		{
 			data.reserve(original_data.size());
-			std::transform(original_data.begin(), original_data.end(),
-				std::back_insert_iterator<std::vector<element_type>>(data), 
-				[](auto& item) { return std::ref(item); });
+			original_data.for_each([this](T& item) { data.push_back(element_type(item)); });
 			interface::make_valid(data);
 		}
 
-		void insert(const T& value)
+		//the returned reference stays valid until the element is removed
+		T& insert(const T& value)
+		{
+			return emplace(value);
+		}
+		T& insert(T&& value)
+		{
+			return emplace(std::move(value));
+		}
+		template<typename... Args>
+		T& emplace(Args&&... args)
 		{
-			original_data.push_back(value);
-			interface::insert(data, std::ref(original_data.back()));
+			auto& item = original_data.emplace(std::forward<Args>(args)...);
+			interface::insert(data, element_type(item));
+			return item;
 		}
 		void replace_top(const T& value)
 		{
@@ -220,12 +526,35 @@ namespace heap
 			else
 			{
 				data[0].get() = value;
+				data[0] = element_type(data[0].get());
 				interface::bubble_down(data, data.size());
 			}
 		}
+		void replace_top(T&& value)
+		{
+			if (data.empty())
+			{
+				insert(std::move(value));
+			}
+			else
+			{
+				data[0].get() = std::move(value);
+				data[0] = element_type(data[0].get());
+				interface::bubble_down(data, data.size());
+			}
+		}
+		//the removed element is moved out of original_data and its slot is reused by later inserts
 		T remove()
 		{
-			return interface::remove(data);
+			return take(interface::remove(data));
+		}
+		T remove(size_t index)
+		{
+			return take(interface::remove(data, index));
+		}
+		void update(size_t index)
+		{
+			interface::update(data, index);
 		}
 
 		bool empty()
@@ -234,59 +563,209 @@ namespace heap
 		}
 	};
 
-	template<typename T, typename comp = std::less<T>>
-	class self_contained_heap : public heap<T, comp>
+	template<typename T, typename comp = std::less<T>, size_t arity = 2>
+	class self_contained_heap : public heap<T, comp, arity>
 	{
 	private:
 		std::vector<T> data;
 	public:
 		self_contained_heap()
-			: heap<T, comp>(data)
+			: heap<T, comp, arity>(data)
 		{
 
 		}
 	};
 
-	template<typename K, typename V, typename comp = std::less<K>>
+	//addressable heap of key-value pairs; the entries are kept in a stable_storage whose chunks come from Allocator
+	template<typename K, typename V, typename comp = std::less<K>, size_t arity = 2, typename Allocator = std::allocator<std::pair<K, V>>>
 	class priority_queue
 	{
 	private:
 		using element_type = std::pair<K, V>;
+		//entries keep their address in stable_storage, so the position written by the tracker stays reachable from a handle
+		struct entry
+		{
+			element_type item;
+			size_t slot;
+			size_t position;
+		};
 		struct key_comparer
 		{
 			static constexpr comp precede = comp{};
-			constexpr bool operator()(element_type left, element_type right) const
+			constexpr bool operator()(const entry& left, const entry& right) const
+			{
+				return precede(left.item.first, right.item.first);
+			}
+		};
+		struct position_tracker
+		{
+			static void placed(entry& element, size_t index)
 			{
-				return precede(left.first, right.first);
+				element.position = index;
 			}
 		};
-		heap_wrapper<element_type, key_comparer> heap;
+		struct slot_type
+		{
+			entry* target;
+			size_t generation;
+			bool occupied;
+		};
+		using entry_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<entry>;
+		static constexpr comp precede = comp{};
+
+		stable_storage<entry, entry_allocator> storage;
+		std::vector<slot_type> slots;
+		std::vector<size_t> free_slots;
+		heap_wrapper<entry, key_comparer, arity, position_tracker, no_prefix, entry_allocator> heap;
+
+		static stable_storage<entry, entry_allocator> to_entries(std::list<element_type>& data, const Allocator& allocator)
+		{
+			stable_storage<entry, entry_allocator> entries{ entry_allocator(allocator) };
+			for (auto& item : data)
+			{
+				entries.emplace(entry{ std::move(item), 0, 0 });
+			}
+			return entries;
+		}
+
+		size_t acquire_slot()
+		{
+			if (free_slots.empty())
+			{
+				slots.push_back({ nullptr, 0, true });
+				return slots.size() - 1;
+			}
+
+			auto slot = free_slots.back();
+			free_slots.pop_back();
+			slots[slot].occupied = true;
+			return slot;
+		}
+		//the entry itself was released by heap_wrapper::remove
+		void release_slot(size_t slot)
+		{
+			slots[slot].occupied = false;
+			slots[slot].generation++;
+			free_slots.push_back(slot);
+		}
+
 	public:
-		priority_queue() = default;
-		priority_queue(std::list<element_type>& data)
-			: heap(data)
+		//refers to an enqueued element until it is dequeued or erased
+		class handle
+		{
+			friend class priority_queue;
+			size_t slot = 0;
+			size_t generation = 0;
+
+			handle(size_t slot, size_t generation)
+				: slot(slot), generation(generation)
+			{
+
+			}
+		public:
+			handle() = default;
+		};
+
+		explicit priority_queue(const Allocator& allocator = Allocator())
+			: storage(entry_allocator(allocator)), heap(storage)
 		{
 
 		}
+		//takes over the elements of data; handles to them are not available
+		priority_queue(std::list<element_type> data, const Allocator& allocator = Allocator())
+			: storage(to_entries(data, allocator)), heap(storage)
+		{
+			slots.reserve(storage.size());
+			storage.for_each([this](entry& item)
+				{
+					item.slot = slots.size();
+					slots.push_back({ &item, 0, true });
+				});
+		}
+		priority_queue(const priority_queue&) = delete;
+		priority_queue& operator=(const priority_queue&) = delete;
 
-		void enqueue(const K& key, const V& value)
+		handle enqueue(K key, V value)
 		{
-			heap.insert({ key, value });
+			auto slot = acquire_slot();
+			try
+			{
+				slots[slot].target = &heap.insert(entry{ { std::move(key), std::move(value) }, slot, 0 });
+			}
+			catch (...)
+			{
+				release_slot(slot);
+				throw;
+			}
+			return { slot, slots[slot].generation };
 		}
 		element_type dequeue()
 		{
-			return heap.remove();
+			auto removed = heap.remove();
+			release_slot(removed.slot);
+			return std::move(removed.item);
 		}
 		bool empty()
 		{
 			return heap.empty();
 		}
+
+		bool contains(const handle& target) const
+		{
+			return target.slot < slots.size() && slots[target.slot].occupied &&
+				slots[target.slot].generation == target.generation;
+		}
+		const K& key(const handle& target) const
+		{
+			return find(target).item.first;
+		}
+		//moves the element towards the top: the new key must not be preceded by the current one
+		void decrease_key(const handle& target, K key)
+		{
+			auto& found = find(target);
+			if (precede(found.item.first, key))
+			{
+				throw std::invalid_argument{ "The new key is preceded by the current one" };
+			}
+
+			found.item.first = std::move(key);
+			heap.update(found.position);
+		}
+		//moves the element towards the bottom: the new key must not precede the current one
+		void increase_key(const handle& target, K key)
+		{
+			auto& found = find(target);
+			if (precede(key, found.item.first))
+			{
+				throw std::invalid_argument{ "The new key precedes the current one" };
+			}
+
+			found.item.first = std::move(key);
+			heap.update(found.position);
+		}
+		element_type erase(const handle& target)
+		{
+			auto removed = heap.remove(find(target).position);
+			release_slot(removed.slot);
+			return std::move(removed.item);
+		}
+
+	private:
+		entry& find(const handle& target) const
+		{
+			if (!contains(target))
+			{
+				throw std::invalid_argument{ "The handle does not refer to an element of the queue" };
+			}
+
+			return *slots[target.slot].target;
+		}
 	};
 
-	template<typename T, typename comp = std::less<T>>
+	template<typename T, typename comp = std::less<T>, size_t arity = 2>
 	void heap_sort(std::vector<T>& v)
 	{
-		interface<T, comp>::make_valid(v);
-		interface<T, comp>::sort(v);
+		interface<T, comp, arity>::make_valid(v);
+		interface<T, comp, arity>::sort(v);
 	}
 }
\ No newline at end of file
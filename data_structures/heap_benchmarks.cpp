@@ -0,0 +1,1127 @@
+#include "stdafx.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "heap.h"
+#include "multi_queue.h"
+#include "pairing_heap.h"
+#include "parallel_heap.h"
+#include "top_k.h"
+#include "external_sort.h"
+#include "radix_heap.h"
+#include "min_max_heap.h"
+#include "priority_channel.h"
+#include "persistent_heap.h"
+#include "sequence_heap.h"
+#include "AVLTree.h"
+#include "ConcurrentAVLTree.h"
+#include "FrozenAVLTree.h"
+#include "legacy_avl_tree.h"
+#include "benchmark.h"
+
+using namespace std;
+using benchmark::muted_output;
+
+template<typename F>
+static long long measure_ms(F&& fn)
+{
+	auto start_point = chrono::steady_clock::now();
+	fn();
+	return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start_point).count();
+}
+
+static void report(const string& name, long long ms)
+{
+	cout << name << ": " << ms << " ms" << endl;
+}
+
+using large_element = array<long long, 16>;
+
+template<typename T>
+static vector<T> random_values(size_t count, mt19937& gen);
+
+template<>
+vector<int> random_values<int>(size_t count, mt19937& gen)
+{
+	uniform_int_distribution<int> dist;
+	vector<int> values(count);
+	for (auto& value : values)
+	{
+		value = dist(gen);
+	}
+	return values;
+}
+
+template<>
+vector<pair<int, int>> random_values<pair<int, int>>(size_t count, mt19937& gen)
+{
+	uniform_int_distribution<int> dist;
+	vector<pair<int, int>> values(count);
+	for (auto& value : values)
+	{
+		value = { dist(gen), dist(gen) };
+	}
+	return values;
+}
+
+template<>
+vector<large_element> random_values<large_element>(size_t count, mt19937& gen)
+{
+	uniform_int_distribution<long long> dist;
+	vector<large_element> values(count);
+	for (auto& value : values)
+	{
+		for (auto& item : value)
+		{
+			item = dist(gen);
+		}
+	}
+	return values;
+}
+
+//builds a heap from the values, inserts them once more and then drains it
+template<typename T, size_t arity>
+static void bench_arity_run(const string& payload, const vector<T>& values)
+{
+	auto buffer = values;
+
+	auto ms = measure_ms([&]()
+		{
+			heap::heap<T, less<T>, arity> h{ buffer };
+			for (auto& value : values)
+			{
+				h.insert(value);
+			}
+			while (!h.empty())
+			{
+				h.remove();
+			}
+		});
+
+	report(payload + ", arity " + to_string(arity), ms);
+}
+
+template<typename T>
+static void bench_arity(const string& payload, size_t count, mt19937& gen)
+{
+	auto values = random_values<T>(count, gen);
+
+	bench_arity_run<T, 2>(payload, values);
+	bench_arity_run<T, 4>(payload, values);
+	bench_arity_run<T, 8>(payload, values);
+}
+
+//the element type used by main.cpp: every sift step used to copy 16 KB several times
+static void bench_vector_elements(size_t count, size_t single_cap, mt19937& gen)
+{
+	uniform_int_distribution<long long> dist;
+	vector<vector<long long>> values(count, vector<long long>(single_cap));
+	for (auto& value : values)
+	{
+		for (auto& item : value)
+		{
+			item = dist(gen);
+		}
+	}
+
+	auto ms = measure_ms([&]()
+		{
+			heap::heap<vector<long long>> h{ values };
+			while (!h.empty())
+			{
+				h.remove();
+			}
+		});
+
+	report("vector<long long>(" + to_string(single_cap) + ") x " + to_string(count) + ", build and drain", ms);
+}
+
+static size_t comparisons = 0;
+
+struct counting_less
+{
+	bool operator()(int left, int right) const
+	{
+		++comparisons;
+		return left < right;
+	}
+};
+
+template<typename F>
+static void report_counted(const string& name, F&& fn)
+{
+	comparisons = 0;
+	auto ms = measure_ms(fn);
+	cout << name << ": " << ms << " ms, " << comparisons << " comparisons" << endl;
+}
+
+//compares Floyd's construction and bottom-up heapsort with the repeated bubble_up build and
+//top-down bubble_down sort they replaced
+static void bench_construction(size_t count, mt19937& gen)
+{
+	using interface = heap::interface<int, counting_less>;
+	auto values = random_values<int>(count, gen);
+
+	auto buffer = values;
+	report_counted("build by repeated bubble_up", [&]()
+		{
+			for (size_t index = 0; index < buffer.size(); index++)
+			{
+				interface::bubble_up(buffer, index);
+			}
+		});
+
+	buffer = values;
+	report_counted("build by Floyd make_valid", [&]() { interface::make_valid(buffer); });
+
+	auto heapified = buffer;
+	report_counted("sort with top-down bubble_down", [&]()
+		{
+			for (size_t end = buffer.size() - 1; end > 0; end--)
+			{
+				interface::swap(buffer, 0, end);
+				interface::bubble_down(buffer, end);
+			}
+		});
+
+	report_counted("sort with bottom-up bubble_down", [&]() { interface::sort(heapified); });
+}
+
+//rank error of a dequeued key = number of smaller keys still in the queue; counted with a Fenwick tree
+static void bench_multi_queue_rank_error(size_t count, size_t threads, size_t relaxation)
+{
+	heap::multi_queue<int> queue(threads, relaxation);
+	for (size_t key = 0; key < count; key++)
+	{
+		queue.enqueue(int(key));
+	}
+
+	vector<size_t> removed_tree(count + 1);
+	auto removed_before = [&](size_t key)
+		{
+			size_t total = 0;
+			for (auto index = key; index > 0; index -= index & (~index + 1))
+			{
+				total += removed_tree[index];
+			}
+			return total;
+		};
+
+	size_t total_error = 0, max_error = 0;
+	int key;
+	while (queue.try_dequeue(key))
+	{
+		auto error = size_t(key) - removed_before(size_t(key));
+		total_error += error;
+		max_error = max(max_error, error);
+
+		for (auto index = size_t(key) + 1; index <= count; index += index & (~index + 1))
+		{
+			removed_tree[index]++;
+		}
+	}
+
+	cout << "relaxation " << relaxation << ", " << threads << " thread(s) worth of heaps: mean rank error " <<
+		double(total_error) / count << ", max " << max_error << endl;
+}
+
+//every thread alternates enqueue and dequeue on a prefilled queue
+static void bench_multi_queue_throughput(size_t threads, size_t operations_per_thread)
+{
+	heap::multi_queue<int> queue(threads);
+	mt19937 gen(5);
+	for (size_t i = 0; i < 100000; i++)
+	{
+		queue.enqueue(int(gen() >> 1));
+	}
+
+	auto ms = measure_ms([&]()
+		{
+			vector<thread> workers;
+			for (size_t t = 0; t < threads; t++)
+			{
+				workers.emplace_back([&, t]()
+					{
+						minstd_rand local(unsigned(t + 1));
+						int value;
+						for (size_t i = 0; i < operations_per_thread; i += 2)
+						{
+							queue.enqueue(int(local() >> 1));
+							queue.try_dequeue(value);
+						}
+					});
+			}
+			for (auto& worker : workers)
+			{
+				worker.join();
+			}
+		});
+
+	auto operations = double(threads * operations_per_thread);
+	cout << threads << " thread(s): " << ms << " ms, " << (ms > 0 ? operations / ms * 1000 : operations) << " ops/sec" << endl;
+}
+
+//rounds of: every worker fills a partial queue, the partials are merged into the main queue and a
+//share of the main queue is popped
+static void bench_meldable(size_t rounds, size_t workers, size_t per_worker, mt19937& gen)
+{
+	auto values = random_values<int>(rounds * workers * per_worker, gen);
+
+	auto vector_ms = measure_ms([&]()
+		{
+			vector<int> main_data;
+			heap::heap<int> main_heap{ main_data };
+			size_t next = 0;
+			for (size_t round = 0; round < rounds; round++)
+			{
+				for (size_t worker = 0; worker < workers; worker++)
+				{
+					vector<int> partial_data;
+					heap::heap<int> partial{ partial_data };
+					for (size_t i = 0; i < per_worker; i++)
+					{
+						partial.insert(values[next++]);
+					}
+					for (auto& value : partial_data)
+					{
+						main_heap.insert(value);
+					}
+				}
+				for (size_t i = 0; i < workers * per_worker / 2; i++)
+				{
+					main_heap.remove();
+				}
+			}
+		});
+	report("heap::heap, merge by inserting", vector_ms);
+
+	auto pairing_ms = measure_ms([&]()
+		{
+			heap::pairing_heap<int> main_heap;
+			size_t next = 0;
+			for (size_t round = 0; round < rounds; round++)
+			{
+				for (size_t worker = 0; worker < workers; worker++)
+				{
+					heap::pairing_heap<int> partial;
+					partial.bulk_insert(values.begin() + next, values.begin() + next + per_worker);
+					next += per_worker;
+					main_heap.merge(partial);
+				}
+				for (size_t i = 0; i < workers * per_worker / 2; i++)
+				{
+					main_heap.remove();
+				}
+			}
+		});
+	report("pairing_heap, O(1) merge", pairing_ms);
+}
+
+template<typename prefix>
+static long long bench_wrapper_prefix_run(const vector<vector<long long>>& values)
+{
+	heap::stable_storage<vector<long long>> storage(values.begin(), values.end());
+
+	return measure_ms([&]()
+		{
+			heap::heap_wrapper<vector<long long>, less<vector<long long>>, 2, heap::untracked, prefix> wrapper{ storage };
+			while (!wrapper.empty())
+			{
+				wrapper.remove();
+			}
+		});
+}
+
+//the main.cpp workload: references into stable_storage slots holding long vectors
+static void bench_wrapper_prefix(size_t count, size_t single_cap, mt19937& gen)
+{
+	uniform_int_distribution<long long> dist;
+	vector<vector<long long>> values(count, vector<long long>(single_cap));
+	for (auto& value : values)
+	{
+		for (auto& item : value)
+		{
+			item = dist(gen);
+		}
+	}
+
+	auto payload = "vector<long long>(" + to_string(single_cap) + ") x " + to_string(count);
+	report(payload + ", no prefix", bench_wrapper_prefix_run<heap::no_prefix>(values));
+	report(payload + ", front_prefix", bench_wrapper_prefix_run<heap::front_prefix<vector<long long>>>(values));
+}
+
+static void bench_parallel(size_t count, size_t threads, mt19937& gen)
+{
+	auto values = random_values<int>(count, gen);
+
+	auto buffer = values;
+	auto build_ms = measure_ms([&]() { heap::parallel_make_valid(buffer, threads); });
+
+	buffer = values;
+	auto sort_ms = measure_ms([&]() { heap::parallel_heap_sort(buffer, threads); });
+
+	cout << threads << " thread(s): make_valid " << build_ms << " ms, heap_sort " << sort_ms << " ms" << endl;
+}
+
+static void bench_top_k(size_t count, size_t k, mt19937& gen)
+{
+	auto stream = random_values<int>(count, gen);
+	long long checksum = 0;
+
+	auto manual_ms = measure_ms([&]()
+		{
+			vector<int> data;
+			heap::heap<int> kept{ data };
+			for (auto value : stream)
+			{
+				if (data.size() < k)
+				{
+					kept.insert(value);
+				}
+				else
+				{
+					//without a threshold check every element pays for a sift
+					kept.replace_top(max(value, data[0]));
+				}
+			}
+			checksum += data[0];
+		});
+	report("heap::heap with replace_top", manual_ms);
+
+	auto single_ms = measure_ms([&]()
+		{
+			heap::top_k<int> kept(k);
+			for (auto value : stream)
+			{
+				kept.push(value);
+			}
+			checksum += kept.threshold();
+		});
+	report("top_k, single pushes", single_ms);
+
+	auto batch_ms = measure_ms([&]()
+		{
+			heap::top_k<int> kept(k);
+			kept.push(stream);
+			checksum += kept.threshold();
+		});
+	report("top_k, one batch", batch_ms);
+
+	cout << "(checksum " << checksum << ")" << endl;
+}
+
+static void bench_external_sort(size_t megabytes, size_t budget_megabytes, mt19937& gen)
+{
+	auto input = (filesystem::temp_directory_path() / "heap_benchmarks_external_input.bin").string();
+	auto output = (filesystem::temp_directory_path() / "heap_benchmarks_external_output.bin").string();
+	{
+		mt19937_64 values(gen());
+		vector<uint64_t> block(1 << 17);
+		ofstream file(input, ios::binary);
+		for (size_t written = 0; written < megabytes; written++)
+		{
+			for (auto& value : block)
+			{
+				value = values();
+			}
+			file.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(uint64_t));
+		}
+	}
+
+	heap::external_sort_stats stats;
+	auto ms = measure_ms([&]() { stats = heap::external_sort<uint64_t>(input, output, budget_megabytes << 20); });
+
+	cout << megabytes << " MB, " << budget_megabytes << " MB budget: " << ms << " ms, " <<
+		(ms > 0 ? double(stats.bytes) / (1 << 20) / ms * 1000 : 0.0) << " MB/s, " <<
+		stats.runs << " runs, " << stats.passes << " passes" << endl;
+
+	filesystem::remove(input);
+	filesystem::remove(output);
+}
+
+//restart of a process owning count elements: reading a dump and rebuilding heap::heap against reopening the heap file
+static void bench_persistent_restart(size_t count, mt19937& gen)
+{
+	auto dump = (filesystem::temp_directory_path() / "heap_benchmarks_dump.bin").string();
+	auto mapped = (filesystem::temp_directory_path() / "heap_benchmarks_persistent.heap").string();
+	filesystem::remove(mapped);
+
+	mt19937_64 keys(gen());
+	vector<uint64_t> values(count);
+	for (auto& value : values)
+	{
+		value = keys();
+	}
+	{
+		ofstream file(dump, ios::binary);
+		file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(values[0]));
+	}
+
+	auto insert_ms = measure_ms([&]()
+		{
+			heap::persistent_heap<uint64_t> stored(mapped, heap::flush_policy::on_close);
+			for (auto& value : values)
+			{
+				stored.insert(value);
+			}
+		});
+	report("persistent_heap, insert " + to_string(count) + " and flush on close", insert_ms);
+
+	auto rebuild_ms = measure_ms([&]()
+		{
+			vector<uint64_t> data(count);
+			ifstream file(dump, ios::binary);
+			file.read(reinterpret_cast<char*>(data.data()), data.size() * sizeof(data[0]));
+			heap::heap<uint64_t> rebuilt{ data };
+		});
+	report("restart by reading a dump and make_valid", rebuild_ms);
+
+	size_t reopened_size = 0;
+	auto reopen_ms = measure_ms([&]()
+		{
+			heap::persistent_heap<uint64_t> stored(mapped, heap::flush_policy::none);
+			reopened_size = stored.size();
+		});
+	report("restart by reopening the heap file (" + to_string(reopened_size) + " elements)", reopen_ms);
+
+	auto synced_ms = measure_ms([&]()
+		{
+			heap::persistent_heap<uint64_t> stored(mapped, heap::flush_policy::every_change);
+			for (size_t index = 0; index < 1000; index++)
+			{
+				stored.replace_top(values[index]);
+			}
+		});
+	report("persistent_heap, 1000 replace_top with a flush after each", synced_ms);
+
+	filesystem::remove(dump);
+	filesystem::remove(mapped);
+}
+
+//insert count random ints, then drain; the cache misses come from perf counters where the kernel grants them.
+//Returns the sum of the removed elements
+template<typename queue>
+static long long bench_sequence_heap_run(const string& name, const vector<int>& values)
+{
+	benchmark::cache_miss_counter counter;
+	long long sum = 0;
+
+	counter.start();
+	auto ms = measure_ms([&]()
+		{
+			vector<int> data;
+			queue target(data);
+			for (auto value : values)
+			{
+				target.insert(value);
+			}
+			while (!target.empty())
+			{
+				sum += target.remove();
+			}
+		});
+	auto misses = counter.stop();
+
+	cout << name << ": " << ms << " ms";
+	if (counter.available())
+	{
+		cout << ", " << misses << " cache misses";
+	}
+	cout << endl;
+	return sum;
+}
+
+//heap::heap works on the caller's vector, sequence_heap owns its storage
+template<typename T>
+struct owning_sequence_heap : heap::sequence_heap<T>
+{
+	explicit owning_sequence_heap(vector<T>&)
+	{
+
+	}
+};
+
+static void bench_sequence_heap(size_t count, mt19937& gen)
+{
+	auto values = random_values<int>(count, gen);
+	auto heap_sum = bench_sequence_heap_run<heap::heap<int>>("heap, " + to_string(count), values);
+	auto sequence_sum = bench_sequence_heap_run<owning_sequence_heap<int>>("sequence_heap, " + to_string(count), values);
+	if (heap_sum != sequence_sum)
+	{
+		cout << "(the removed elements differ)" << endl;
+	}
+}
+
+//same order as std::less, but not matched by the SIMD child_selector specializations
+template<typename T>
+struct generic_less
+{
+	bool operator()(const T& left, const T& right) const
+	{
+		return left < right;
+	}
+};
+
+template<typename T, typename comp, size_t arity>
+static void bench_child_selection_run(const string& name, const vector<T>& values)
+{
+	auto buffer = values;
+	auto ms = measure_ms([&]()
+		{
+			heap::heap_sort<T, comp, arity>(buffer);
+		});
+	report(name + ", arity " + to_string(arity), ms);
+}
+
+static void bench_child_selection(size_t count, mt19937& gen)
+{
+	auto ints = random_values<int>(count, gen);
+	bench_child_selection_run<int, generic_less<int>, 2>("int, generic", ints);
+	bench_child_selection_run<int, generic_less<int>, 8>("int, generic", ints);
+	bench_child_selection_run<int, less<int>, 8>("int, SIMD", ints);
+
+	vector<float> floats(ints.begin(), ints.end());
+	bench_child_selection_run<float, generic_less<float>, 8>("float, generic", floats);
+	bench_child_selection_run<float, less<float>, 8>("float, SIMD", floats);
+}
+
+//a bounded cache that keeps the capacity largest keys and serves the largest one every few inserts
+static void bench_bounded_cache(size_t operations, size_t capacity, mt19937& gen)
+{
+	auto values = random_values<int>(operations, gen);
+	long long served = 0;
+
+	auto min_max_ms = measure_ms([&]()
+		{
+			vector<int> data;
+			heap::min_max_heap<int> cache{ data, capacity };
+			for (size_t index = 0; index < values.size(); index++)
+			{
+				cache.insert(values[index]);
+				if (index % 4 == 3)
+				{
+					served += cache.pop_max();
+				}
+			}
+		});
+	report("min_max_heap", min_max_ms);
+
+	auto multiset_ms = measure_ms([&]()
+		{
+			multiset<int> cache;
+			for (size_t index = 0; index < values.size(); index++)
+			{
+				cache.insert(values[index]);
+				if (cache.size() > capacity)
+				{
+					cache.erase(cache.begin());
+				}
+				if (index % 4 == 3)
+				{
+					served -= *prev(cache.end());
+					cache.erase(prev(cache.end()));
+				}
+			}
+		});
+	report("multiset", multiset_ms);
+
+	if (served != 0)
+	{
+		cout << "the caches served different elements" << endl;
+	}
+}
+
+//producers stamp every element with its enqueue time and consumers record how long it waited;
+//priorities come from a few classes, as for prioritized tasks
+static void bench_channel_latency(size_t producers, size_t consumers, size_t per_producer, size_t batch, size_t capacity)
+{
+	using stamp = chrono::steady_clock;
+	heap::priority_channel<int, stamp::time_point> channel(capacity);
+	vector<vector<double>> waited(consumers);
+
+	auto ms = measure_ms([&]()
+		{
+			vector<thread> consumer_threads;
+			for (size_t consumer = 0; consumer < consumers; consumer++)
+			{
+				consumer_threads.emplace_back([&, consumer]()
+					{
+						vector<pair<int, stamp::time_point>> buffer(batch);
+						while (auto taken = channel.dequeue_n(buffer.begin(), batch))
+						{
+							auto now = stamp::now();
+							for (size_t index = 0; index < taken; index++)
+							{
+								waited[consumer].push_back(double(chrono::duration_cast<chrono::nanoseconds>(now - buffer[index].second).count()));
+							}
+						}
+					});
+			}
+
+			vector<thread> producer_threads;
+			for (size_t producer = 0; producer < producers; producer++)
+			{
+				producer_threads.emplace_back([&, producer]()
+					{
+						minstd_rand gen(unsigned(producer + 1));
+						vector<pair<int, stamp::time_point>> items;
+						for (size_t sent = 0; sent < per_producer; sent += batch)
+						{
+							items.clear();
+							auto now = stamp::now();
+							for (size_t index = 0; index < batch; index++)
+							{
+								items.emplace_back(int(gen() % 8), now);
+							}
+							channel.enqueue(items.begin(), items.end());
+						}
+					});
+			}
+
+			for (auto& worker : producer_threads)
+			{
+				worker.join();
+			}
+			channel.close();
+			for (auto& worker : consumer_threads)
+			{
+				worker.join();
+			}
+		});
+
+	vector<double> all;
+	for (auto& samples : waited)
+	{
+		all.insert(all.end(), samples.begin(), samples.end());
+	}
+	sort(all.begin(), all.end());
+
+	cout << producers << " producer(s), " << consumers << " consumer(s), batches of " << batch << ", capacity " << capacity <<
+		": p50 " << benchmark::percentile(all, 0.5) / 1000 << " us, p99 " << benchmark::percentile(all, 0.99) / 1000 <<
+		" us, " << ms << " ms total" << endl;
+}
+
+using graph = vector<vector<pair<unsigned, unsigned>>>;
+
+//side x side grid with random weights, roughly what a road network looks like to Dijkstra
+static graph grid_graph(unsigned side, unsigned max_weight, mt19937& gen)
+{
+	uniform_int_distribution<unsigned> weight(1, max_weight);
+	graph edges(size_t{ side } * side);
+	for (unsigned row = 0; row < side; row++)
+	{
+		for (unsigned column = 0; column < side; column++)
+		{
+			auto vertex = row * side + column;
+			if (column + 1 < side)
+			{
+				auto w = weight(gen);
+				edges[vertex].emplace_back(vertex + 1, w);
+				edges[vertex + 1].emplace_back(vertex, w);
+			}
+			if (row + 1 < side)
+			{
+				auto w = weight(gen);
+				edges[vertex].emplace_back(vertex + side, w);
+				edges[vertex + side].emplace_back(vertex, w);
+			}
+		}
+	}
+	return edges;
+}
+
+static graph random_graph(unsigned vertices, unsigned degree, unsigned max_weight, mt19937& gen)
+{
+	uniform_int_distribution<unsigned> target(0, vertices - 1), weight(1, max_weight);
+	graph edges(vertices);
+	for (auto& adjacent : edges)
+	{
+		for (unsigned i = 0; i < degree; i++)
+		{
+			adjacent.emplace_back(target(gen), weight(gen));
+		}
+	}
+	return edges;
+}
+
+//Dijkstra from vertex 0 with lazy deletion: stale entries are skipped when dequeued. Returns the sum of the distances
+template<typename queue>
+static unsigned long long dijkstra(const graph& edges)
+{
+	vector<unsigned> distance(edges.size(), numeric_limits<unsigned>::max());
+	queue pending;
+	distance[0] = 0;
+	pending.enqueue(0, 0);
+	while (!pending.empty())
+	{
+		auto top = pending.dequeue();
+		if (top.first != distance[top.second])
+		{
+			continue;
+		}
+		for (auto& edge : edges[top.second])
+		{
+			auto candidate = top.first + edge.second;
+			if (candidate < distance[edge.first])
+			{
+				distance[edge.first] = candidate;
+				pending.enqueue(candidate, edge.first);
+			}
+		}
+	}
+
+	unsigned long long sum = 0;
+	for (auto value : distance)
+	{
+		sum += value == numeric_limits<unsigned>::max() ? 0 : value;
+	}
+	return sum;
+}
+
+static void bench_monotone(const string& name, const graph& edges)
+{
+	unsigned long long heap_sum = 0, radix_sum = 0;
+	auto heap_ms = measure_ms([&]()
+		{
+			heap_sum = dijkstra<heap::priority_queue<unsigned, unsigned>>(edges);
+		});
+	auto radix_ms = measure_ms([&]()
+		{
+			radix_sum = dijkstra<heap::radix_heap<unsigned, unsigned>>(edges);
+		});
+
+	cout << name << ": priority_queue " << heap_ms << " ms, radix_heap " << radix_ms << " ms" <<
+		(heap_sum == radix_sum ? "" : " (distances differ)") << endl;
+}
+
+//heap bytes in use where glibc reports them, -1 elsewhere
+static long long allocated_bytes()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+	auto info = mallinfo2();
+	return static_cast<long long>(info.uordblks + info.hblkhd);
+#else
+	return -1;
+#endif
+}
+
+static void report_tree(const string& name, long long insert_ms, long long search_ms, long long teardown_ms, long long bytes, size_t count)
+{
+	cout << name << ": insert " << insert_ms << " ms, search " << search_ms << " ms, teardown " << teardown_ms << " ms";
+	if (bytes >= 0)
+	{
+		cout << ", " << bytes / static_cast<double>(count) << " bytes per element";
+	}
+	cout << endl;
+}
+
+//distinct random keys, so that both trees hold count elements
+static void bench_avl_tree(size_t count, mt19937& gen)
+{
+	auto values = random_values<int>(count, gen);
+	sort(values.begin(), values.end());
+	values.erase(unique(values.begin(), values.end()), values.end());
+	shuffle(values.begin(), values.end(), gen);
+	count = values.size();
+
+	{
+		long long found = 0, bytes = 0;
+		auto before = allocated_bytes();
+		auto tree = new legacy::AVLTree();
+		auto insert_ms = measure_ms([&]()
+			{
+				muted_output muted;
+				for (auto value : values)
+				{
+					tree->insert(value);
+				}
+			});
+		bytes = before < 0 ? -1 : allocated_bytes() - before;
+		auto search_ms = measure_ms([&]()
+			{
+				for (auto value : values)
+				{
+					found += tree->search(value) != nullptr;
+				}
+			});
+		auto teardown_ms = measure_ms([&]()
+			{
+				for (auto node : tree->traverse_inorder(tree->root))
+				{
+					delete node;
+				}
+				delete tree;
+			});
+		report_tree("legacy::AVLTree, " + to_string(found) + " found", insert_ms, search_ms, teardown_ms, bytes, count);
+	}
+	{
+		long long found = 0, bytes = 0;
+		auto before = allocated_bytes();
+		auto tree = new AVLTree<int>();
+		auto insert_ms = measure_ms([&]()
+			{
+				for (auto value : values)
+				{
+					tree->insert(value);
+				}
+			});
+		bytes = before < 0 ? -1 : allocated_bytes() - before;
+		auto search_ms = measure_ms([&]()
+			{
+				for (auto value : values)
+				{
+					found += tree->contains(value);
+				}
+			});
+		auto teardown_ms = measure_ms([&]() { delete tree; });
+		report_tree("AVLTree<int>, " + to_string(found) + " found", insert_ms, search_ms, teardown_ms, bytes, count);
+	}
+}
+
+//lookups of random keys, half of them present, in a set of count distinct ints; reports nanoseconds per lookup
+static void bench_frozen_lookup(size_t count, size_t lookups, mt19937& gen)
+{
+	AVLTree<int> tree;
+	uniform_int_distribution<int> dist(0, numeric_limits<int>::max() / 2);
+	while (tree.size() < count)
+	{
+		tree.insert(dist(gen) * 2);
+	}
+	auto eytzinger = tree.freeze();
+	auto blocks = tree.freeze<FrozenLayout::blocks>();
+	vector<int> sorted;
+	sorted.reserve(count);
+	for (auto node : tree)
+	{
+		sorted.push_back(node->key);
+	}
+
+	vector<int> probes(lookups);
+	for (auto& probe : probes)
+	{
+		probe = gen() & 1 ? sorted[gen() % count] : dist(gen) * 2 + 1;
+	}
+
+	auto run = [&](const string& name, auto contains)
+		{
+			size_t found = 0;
+			auto ms = measure_ms([&]()
+				{
+					for (auto probe : probes)
+					{
+						found += contains(probe);
+					}
+				});
+			cout << "  " << name << ": " << double(ms) * 1000000 / double(lookups) << " ns/lookup, " << found << " found" << endl;
+		};
+
+	cout << count << " keys, " << count * sizeof(int) / 1024 << " KiB of keys:" << endl;
+	run("AVLTree<int>::contains", [&](int key) { return tree.contains(key); });
+	run("FrozenAVLTree eytzinger", [&](int key) { return eytzinger.contains(key); });
+	run("FrozenAVLTree blocks", [&](int key) { return blocks.contains(key); });
+	run("binary_search on a sorted vector", [&](int key) { return binary_search(sorted.begin(), sorted.end(), key); });
+}
+
+//AVLTree<int> behind a reader-writer lock, the baseline of the concurrent tree
+class locked_avl_tree
+{
+	AVLTree<int> tree;
+	mutable shared_mutex lock;
+
+public:
+	bool contains(int key) const
+	{
+		shared_lock<shared_mutex> guard(lock);
+		return tree.contains(key);
+	}
+
+	bool insert(int key)
+	{
+		unique_lock<shared_mutex> guard(lock);
+		return tree.insert(key);
+	}
+
+	bool erase(int key)
+	{
+		unique_lock<shared_mutex> guard(lock);
+		return tree.erase(key);
+	}
+};
+
+//every thread runs a mix of contains and an insert or erase of a random key in every tenth
+//operation, over a key range twice the initial size so that the tree stays about half full
+template<typename tree_type>
+static void bench_concurrent_tree_run(const string& name, size_t threads, size_t key_range, size_t operations_per_thread)
+{
+	tree_type tree;
+	for (size_t key = 0; key < key_range; key += 2)
+	{
+		tree.insert(int(key));
+	}
+
+	atomic<size_t> found{ 0 };
+	auto ms = measure_ms([&]()
+		{
+			vector<thread> workers;
+			for (size_t t = 0; t < threads; t++)
+			{
+				workers.emplace_back([&, t]()
+					{
+						minstd_rand local(unsigned(t + 1));
+						size_t hits = 0;
+						for (size_t i = 0; i < operations_per_thread; i++)
+						{
+							auto key = int(local() % key_range);
+							if (i % 10 != 9)
+							{
+								hits += tree.contains(key);
+							}
+							else if (local() & 1)
+							{
+								tree.insert(key);
+							}
+							else
+							{
+								tree.erase(key);
+							}
+						}
+						found += hits;
+					});
+			}
+			for (auto& worker : workers)
+			{
+				worker.join();
+			}
+		});
+
+	auto operations = double(threads * operations_per_thread);
+	cout << name << ", " << threads << " thread(s): " << ms << " ms, " << (ms > 0 ? operations / ms * 1000 : operations) << " ops/sec, " << found.load() << " found" << endl;
+}
+
+static void bench_concurrent_tree(size_t threads, size_t key_range, size_t operations_per_thread)
+{
+	bench_concurrent_tree_run<locked_avl_tree>("AVLTree<int> + shared_mutex", threads, key_range, operations_per_thread);
+	bench_concurrent_tree_run<ConcurrentAVLTree<int>>("ConcurrentAVLTree<int>", threads, key_range, operations_per_thread);
+}
+
+void run_benchmarks()
+{
+	mt19937 gen(42);
+	auto max_threads = max<size_t>(thread::hardware_concurrency(), 1);
+
+	cout << endl << "d-ary heap (build, insert, drain):" << endl;
+	bench_arity<int>("int x 1000000", 1000000, gen);
+	bench_arity<pair<int, int>>("pair<int, int> x 1000000", 1000000, gen);
+	bench_arity<large_element>("array<long long, 16> x 100000", 100000, gen);
+
+	cout << endl << "large movable elements:" << endl;
+	bench_vector_elements(20000, 2000, gen);
+
+	cout << endl << "heap_wrapper build and drain:" << endl;
+	bench_wrapper_prefix(50000, 2000, gen);
+	bench_wrapper_prefix(1000000, 16, gen);
+
+	cout << endl << "heap construction and heap_sort, int x 1000000:" << endl;
+	bench_construction(1000000, gen);
+
+	cout << endl << "heap_sort child selection, 2000000 elements:" << endl;
+	bench_child_selection(2000000, gen);
+
+	cout << endl << "meldable heaps, 50 rounds of 8 merged partial queues x 10000 ints:" << endl;
+	bench_meldable(50, 8, 10000, gen);
+
+	cout << endl << "top 100 of 50000000 ints:" << endl;
+	bench_top_k(50000000, 100, gen);
+
+	cout << endl << "bounded cache of 10000 ints, 4000000 inserts, every 4th serves the largest:" << endl;
+	bench_bounded_cache(4000000, 10000, gen);
+
+	cout << endl << "priority_channel enqueue-to-dequeue latency, 200000 elements per producer:" << endl;
+	bench_channel_latency(4, 4, 200000, 1, 1024);
+	bench_channel_latency(4, 4, 200000, 16, 1024);
+	bench_channel_latency(4, 1, 200000, 16, 1024);
+	bench_channel_latency(1, 4, 200000, 16, 64);
+
+	cout << endl << "Dijkstra with lazy deletion:" << endl;
+	bench_monotone("grid 1000 x 1000, weights up to 100", grid_graph(1000, 100, gen));
+	bench_monotone("random 1000000 vertices x 8 edges, weights up to 1000000", random_graph(1000000, 8, 1000000, gen));
+
+	cout << endl << "external_sort of uint64_t:" << endl;
+	bench_external_sort(128, 32, gen);
+	bench_external_sort(128, 4, gen);
+
+	cout << endl << "insert and drain random ints, binary heap against sequence heap:" << endl;
+	if (!benchmark::cache_miss_counter().available())
+	{
+		cout << "(cache misses are not reported: perf counters are not available)" << endl;
+	}
+	for (size_t count = 100000; count <= 10000000; count *= 10)
+	{
+		bench_sequence_heap(count, gen);
+	}
+
+	cout << endl << "AVLTree of 1000000 random ints against the pointer-based original:" << endl;
+	bench_avl_tree(1000000, gen);
+
+	cout << endl << "frozen AVLTree lookups, 4000000 random ints of which half are present, from L1- to DRAM-sized sets:" << endl;
+	for (size_t count = 1000; count <= 10000000; count *= 10)
+	{
+		bench_frozen_lookup(count, 4000000, gen);
+	}
+
+	cout << endl << "restart with a persistent heap:" << endl;
+	bench_persistent_restart(4000000, gen);
+
+	cout << endl << "multi_queue rank error, 100000 sequential dequeues:" << endl;
+	bench_multi_queue_rank_error(100000, 4, 1);
+	bench_multi_queue_rank_error(100000, 4, 2);
+	bench_multi_queue_rank_error(100000, 4, 4);
+
+	cout << endl << "parallel make_valid and heap_sort, int x 4000000:" << endl;
+	for (size_t threads = 1; ; threads = min(threads * 2, max_threads))
+	{
+		bench_parallel(4000000, threads, gen);
+		if (threads == max_threads)
+		{
+			break;
+		}
+	}
+
+	cout << endl << "multi_queue throughput, 1000000 operations per thread:" << endl;
+	for (size_t threads = 1; ; threads = min(threads * 2, max_threads))
+	{
+		bench_multi_queue_throughput(threads, 1000000);
+		if (threads == max_threads)
+		{
+			break;
+		}
+	}
+
+	cout << endl << "concurrent AVL trees over 1000000 keys, 90% contains, 10% insert or erase, 1000000 operations per thread:" << endl;
+	for (size_t threads = 1; ; threads = min(threads * 2, max_threads))
+	{
+		bench_concurrent_tree(threads, 1000000, 1000000);
+		if (threads == max_threads)
+		{
+			break;
+		}
+	}
+}
@@ -1,13 +1,39 @@
 #include "stdafx.h"
 
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
 #include <functional>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <random>
+#include <set>
 #include <stdexcept>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
 #include "heap.h"
+#include "multi_queue.h"
+#include "pairing_heap.h"
+#include "parallel_heap.h"
+#include "top_k.h"
+#include "external_sort.h"
+#include "radix_heap.h"
+#include "min_max_heap.h"
+#include "priority_channel.h"
+#include "persistent_heap.h"
+#include "sequence_heap.h"
+#include "stable_storage.h"
+#include "AVLTree.h"
+#include "ConcurrentAVLTree.h"
 
 using namespace std;
 
@@ -30,6 +56,36 @@ static void expect_eq_int(size_t a, size_t b, const string& msg)
 		throw runtime_error(msg + "  got: " + to_string(a) + " expected: " + to_string(b));
 }
 
+struct unique_ptr_less
+{
+	bool operator()(const unique_ptr<int>& left, const unique_ptr<int>& right) const
+	{
+		return *left < *right;
+	}
+};
+
+#ifdef HEAP_CHANNEL_COROUTINES
+//runs until its first co_await and is then resumed by whoever supplies the awaited element
+struct detached_task
+{
+	struct promise_type
+	{
+		detached_task get_return_object() { return {}; }
+		suspend_never initial_suspend() { return {}; }
+		suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { terminate(); }
+	};
+};
+
+static detached_task consume(heap::priority_channel<int, int>& channel, vector<int>& received, bool& finished)
+{
+	while (auto item = co_await channel.dequeue())
+		received.push_back(item->first);
+	finished = true;
+}
+#endif
+
 static void expect_eq_vec(const vector<int>& a, const vector<int>& b, const string& msg)
 {
 	if (a != b)
@@ -102,6 +158,1512 @@ bool run_tests()
 			expect_eq_int(first, 1, "replace_top did not set new minimum at top");
 		});
 
+	run("d-ary indices and ordering (arity 4 and 8)", []()
+		{
+			expect_eq_int(heap::interface<int, less<int>, 4>::parent_index(4), 0, "4-ary parent_index(4)");
+			expect_eq_int(heap::interface<int, less<int>, 4>::parent_index(5), 1, "4-ary parent_index(5)");
+			expect_eq_int(heap::interface<int, less<int>, 4>::left_index(1), 5, "4-ary left_index(1)");
+			expect_eq_int(heap::interface<int, less<int>, 4>::right_index(1), 8, "4-ary right_index(1)");
+
+			vector<int> v = { 9,4,7,1,8,2,6,3,5,0,11,10 };
+			heap::heap<int, less<int>, 4> h{ v };
+			vector<int> removed;
+			while (!h.empty())
+				removed.push_back(h.remove());
+
+			vector<int> expected = { 0,1,2,3,4,5,6,7,8,9,10,11 };
+			expect_eq_vec(removed, expected, "4-ary removal sequence");
+
+			vector<int> s = { 3,14,15,9,2,6,5,35,8,97,93,23,84 };
+			vector<int> sorted_desc = s;
+			sort(sorted_desc.begin(), sorted_desc.end(), greater<int>());
+			heap::heap_sort<int, less<int>, 8>(s);
+			expect_eq_vec(s, sorted_desc, "8-ary heap_sort result");
+		});
+
+	run("move-only elements (unique_ptr) in heap, heap_wrapper and priority_queue", []()
+		{
+			vector<unique_ptr<int>> v;
+			heap::heap<unique_ptr<int>, unique_ptr_less> h{ v };
+			h.insert(make_unique<int>(5));
+			h.emplace(new int(2));
+			h.insert(make_unique<int>(7));
+			h.replace_top(make_unique<int>(6));
+
+			vector<int> removed;
+			while (!h.empty())
+				removed.push_back(*h.remove());
+			expect_eq_vec(removed, { 5,6,7 }, "heap removal sequence");
+
+			heap::stable_storage<unique_ptr<int>> storage;
+			heap::heap_wrapper<unique_ptr<int>, unique_ptr_less> w{ storage };
+			w.insert(make_unique<int>(3));
+			w.emplace(new int(1));
+			w.insert(make_unique<int>(2));
+
+			removed.clear();
+			while (!w.empty())
+				removed.push_back(*w.remove());
+			expect_eq_vec(removed, { 1,2,3 }, "heap_wrapper removal sequence");
+
+			heap::priority_queue<int, unique_ptr<int>> q;
+			q.enqueue(2, make_unique<int>(20));
+			q.enqueue(1, make_unique<int>(10));
+
+			auto first = q.dequeue();
+			expect_eq_int(first.first, 1, "priority_queue dequeued key");
+			expect_eq_int(*first.second, 10, "priority_queue dequeued value");
+		});
+
+	run("Floyd make_valid and bottom-up heap_sort on random input", []()
+		{
+			mt19937 gen(7);
+			uniform_int_distribution<int> dist(-1000, 1000);
+
+			for (size_t size : { 0, 1, 2, 3, 10, 257, 1000 })
+			{
+				vector<int> v(size);
+				for (auto& item : v)
+					item = dist(gen);
+
+				vector<int> valid = v;
+				heap::interface<int>::make_valid(valid);
+				for (size_t i = 1; i < valid.size(); ++i)
+					if (valid[i] < valid[heap::interface<int>::parent_index(i)])
+						throw runtime_error("make_valid broke the heap property at " + to_string(i));
+
+				vector<int> expected = v;
+				sort(expected.begin(), expected.end(), greater<int>());
+
+				vector<int> binary = v;
+				heap::heap_sort(binary);
+				expect_eq_vec(binary, expected, "binary heap_sort of size " + to_string(size));
+
+				vector<int> quaternary = v;
+				heap::heap_sort<int, less<int>, 4>(quaternary);
+				expect_eq_vec(quaternary, expected, "4-ary heap_sort of size " + to_string(size));
+			}
+		});
+
+	run("priority_queue handles: decrease_key, increase_key, erase, contains", []()
+		{
+			heap::priority_queue<int, int> q;
+			auto a = q.enqueue(50, 1);
+			auto b = q.enqueue(40, 2);
+			auto c = q.enqueue(30, 3);
+			auto d = q.enqueue(20, 4);
+
+			q.decrease_key(a, 10);
+			q.increase_key(d, 60);
+			expect_eq_int(q.erase(c).second, 3, "erased value");
+			if (q.contains(c))
+				throw runtime_error("erased handle is still contained");
+
+			vector<int> values;
+			while (!q.empty())
+				values.push_back(q.dequeue().second);
+			expect_eq_vec(values, { 1,2,4 }, "dequeued values after key changes");
+
+			if (q.contains(a) || q.contains(b) || q.contains(d))
+				throw runtime_error("dequeued handle is still contained");
+
+			auto e = q.enqueue(5, 5);
+			if (!q.contains(e) || q.contains(a))
+				throw runtime_error("recycled slot confused handles");
+
+			try
+			{
+				q.decrease_key(e, 6);
+				throw runtime_error("decrease_key accepted a larger key");
+			}
+			catch (const invalid_argument&)
+			{
+				// expected
+			}
+
+			struct throwing_value
+			{
+				bool fail;
+				explicit throwing_value(bool fail) : fail(fail) {}
+				throwing_value(throwing_value&& other) : fail(other.fail)
+				{
+					if (fail)
+						throw runtime_error("value move failed");
+				}
+				throwing_value& operator=(throwing_value&&) = default;
+			};
+			heap::priority_queue<int, throwing_value> guarded;
+			try
+			{
+				guarded.enqueue(1, throwing_value(true));
+				throw logic_error("the value move did not throw");
+			}
+			catch (const runtime_error&)
+			{
+				// expected
+			}
+			//the slot taken by the failed enqueue is released, so no handle refers to it
+			if (guarded.contains({}))
+				throw runtime_error("failed enqueue left its slot occupied");
+			guarded.enqueue(2, throwing_value(false));
+			expect_eq_int(guarded.dequeue().first, 2, "enqueue after a failed one");
+		});
+
+	run("priority_queue handles match a reference model on random operations", []()
+		{
+			mt19937 gen(11);
+			uniform_int_distribution<int> key_dist(0, 10000);
+			heap::priority_queue<int, int, less<int>, 4> q;
+			vector<pair<decltype(q.enqueue(0, 0)), int>> live;
+
+			for (int step = 0; step < 5000; ++step)
+			{
+				auto action = gen() % 5;
+				if (action < 2 || live.empty())
+				{
+					auto key = key_dist(gen);
+					live.push_back({ q.enqueue(key, step), key });
+				}
+				else if (action == 2)
+				{
+					auto& target = live[gen() % live.size()];
+					target.second = uniform_int_distribution<int>(0, target.second)(gen);
+					q.decrease_key(target.first, target.second);
+				}
+				else if (action == 3)
+				{
+					auto& target = live[gen() % live.size()];
+					target.second = uniform_int_distribution<int>(target.second, 10000)(gen);
+					q.increase_key(target.first, target.second);
+				}
+				else
+				{
+					auto index = gen() % live.size();
+					expect_eq_int(q.erase(live[index].first).first, live[index].second, "erased key");
+					live.erase(live.begin() + index);
+				}
+			}
+
+			vector<int> expected;
+			for (auto& item : live)
+				expected.push_back(item.second);
+			sort(expected.begin(), expected.end());
+
+			vector<int> keys;
+			while (!q.empty())
+				keys.push_back(q.dequeue().first);
+			expect_eq_vec(keys, expected, "dequeued keys");
+		});
+
+	run("position tracking with the vector-backed heap", []()
+		{
+			struct tracked
+			{
+				int key;
+				size_t* position;
+			};
+			struct tracked_less
+			{
+				bool operator()(const tracked& left, const tracked& right) const { return left.key < right.key; }
+			};
+			struct tracker
+			{
+				static void placed(const tracked& element, size_t index) { *element.position = index; }
+			};
+
+			deque<size_t> positions(6);
+			vector<tracked> v;
+			for (size_t i = 0; i < positions.size(); ++i)
+				v.push_back({ int(60 - 10 * i), &positions[i] });
+
+			heap::heap<tracked, tracked_less, 2, tracker> h{ v };
+			for (size_t i = 0; i < positions.size(); ++i)
+				expect_eq_int(v[positions[i]].key, 60 - 10 * i, "position after make_valid");
+
+			v[positions[0]].key = 5;
+			h.update(positions[0]);
+			h.remove(positions[3]);
+			for (size_t i : { 0, 1, 2, 4, 5 })
+				if (v[positions[i]].position != &positions[i])
+					throw runtime_error("position after update/remove is stale for element " + to_string(i));
+
+			vector<int> keys;
+			while (!h.empty())
+				keys.push_back(h.remove().key);
+			expect_eq_vec(keys, { 5,10,20,40,50 }, "removal sequence");
+		});
+
+	run("multi_queue: exact order with one heap, no loss across threads", []()
+		{
+			heap::multi_queue<int> single(1, 1);
+			vector<int> input = { 5,3,9,1,7 };
+			single.enqueue(input.begin(), input.end());
+
+			vector<int> removed;
+			int value;
+			while (single.try_dequeue(value))
+				removed.push_back(value);
+			expect_eq_vec(removed, { 1,3,5,7,9 }, "single heap removal sequence");
+
+			heap::multi_queue<int> shared(4, 2);
+			constexpr int per_thread = 5000;
+			vector<vector<int>> taken(4);
+			vector<thread> workers;
+			for (int t = 0; t < 4; ++t)
+			{
+				workers.emplace_back([&, t]()
+					{
+						for (int i = 0; i < per_thread; ++i)
+						{
+							shared.enqueue(t * per_thread + i);
+							if (i % 2 == 1)
+							{
+								int out[2];
+								auto count = shared.dequeue(out, 2);
+								taken[t].insert(taken[t].end(), out, out + count);
+							}
+						}
+					});
+			}
+			for (auto& worker : workers)
+				worker.join();
+
+			vector<int> all;
+			for (auto& part : taken)
+				all.insert(all.end(), part.begin(), part.end());
+			while (shared.try_dequeue(value))
+				all.push_back(value);
+			sort(all.begin(), all.end());
+
+			vector<int> expected(4 * per_thread);
+			for (size_t i = 0; i < expected.size(); ++i)
+				expected[i] = int(i);
+			expect_eq_vec(all, expected, "every element dequeued exactly once");
+		});
+
+	run("pairing_heap: insert, bulk_insert, merge and remove", []()
+		{
+			mt19937 gen(3);
+			uniform_int_distribution<int> dist(-500, 500);
+
+			heap::pairing_heap<int> first, second;
+			vector<int> expected;
+			for (int i = 0; i < 300; ++i)
+			{
+				auto value = dist(gen);
+				(i % 2 ? first : second).insert(value);
+				expected.push_back(value);
+			}
+
+			vector<int> bulk(200);
+			for (auto& item : bulk)
+				item = dist(gen);
+			//150 elements in chunks of 64, 64 and 128 leave 106 slots, so only 94 nodes are added
+			second.bulk_insert(bulk.begin(), bulk.end());
+			expected.insert(expected.end(), bulk.begin(), bulk.end());
+			expect_eq_int(second.capacity(), 350, "bulk_insert fills the current chunk first");
+
+			istringstream stream("5 -3 8");
+			heap::pairing_heap<int> streamed;
+			streamed.bulk_insert(istream_iterator<int>(stream), istream_iterator<int>());
+			expect_eq_int(streamed.size(), 3, "bulk_insert from an input iterator");
+			expect_eq_int(streamed.remove(), -3, "smallest streamed element");
+
+			for (int i = 0; i < 50; ++i)
+			{
+				auto value = first.remove();
+				first.insert(value);
+			}
+
+			first.merge(second);
+			if (!second.empty())
+				throw runtime_error("merged heap is not empty");
+			expect_eq_int(first.size(), expected.size(), "size after merge");
+
+			first.replace_top(-1000);
+			expected.erase(min_element(expected.begin(), expected.end()));
+			expected.push_back(-1000);
+
+			second.insert(7);
+			expected.push_back(7);
+			first.merge(second);
+
+			vector<int> removed;
+			while (!first.empty())
+				removed.push_back(first.remove());
+			sort(expected.begin(), expected.end());
+			expect_eq_vec(removed, expected, "removal sequence");
+
+			heap::pairing_heap<unique_ptr<int>, unique_ptr_less> owning;
+			owning.emplace(new int(2));
+			owning.insert(make_unique<int>(1));
+			owning.insert(make_unique<int>(3));
+			expect_eq_int(*owning.remove(), 1, "move-only removal");
+		});
+
+	run("heap_wrapper with cached key prefixes", []()
+		{
+			heap::stable_storage<vector<long long>> sequences = { { 3, 1 }, { 1, 9 }, {}, { 1, 2, 3 }, { 1, 2 }, { -4 }, { 3 } };
+			heap::heap_wrapper<vector<long long>, less<vector<long long>>, 2, heap::untracked,
+				heap::front_prefix<vector<long long>>> sequence_heap{ sequences };
+			sequence_heap.insert({ 1, 2, 0 });
+			sequence_heap.replace_top({ 2 });
+
+			vector<vector<long long>> expected = { { -4 }, { 1, 2 }, { 1, 2, 0 }, { 1, 2, 3 }, { 1, 9 }, { 2 }, { 3 }, { 3, 1 } };
+			vector<vector<long long>> removed;
+			while (!sequence_heap.empty())
+				removed.push_back(sequence_heap.remove());
+			if (removed != expected)
+				throw runtime_error("front_prefix removal sequence is out of order");
+
+			vector<string> expected_words = { "prefixed", "prefix", "pre", "prefixes", "\xff", "a", "prefixe", "" };
+			heap::stable_storage<string> words(expected_words.begin(), expected_words.end());
+			heap::heap_wrapper<string, less<string>, 4, heap::untracked, heap::string_prefix> word_heap{ words };
+			sort(expected_words.begin(), expected_words.end());
+
+			vector<string> removed_words;
+			while (!word_heap.empty())
+				removed_words.push_back(word_heap.remove());
+			if (removed_words != expected_words)
+				throw runtime_error("string_prefix removal sequence is out of order");
+		});
+
+	run("parallel_make_valid and parallel_heap_sort match the sequential versions", []()
+		{
+			mt19937 gen(13);
+			uniform_int_distribution<int> dist(-100000, 100000);
+
+			for (size_t threads : { 1, 2, 3, 8 })
+			{
+				vector<int> v(heap::parallel_threshold * 3 + 17);
+				for (auto& item : v)
+					item = dist(gen);
+
+				vector<int> valid = v;
+				heap::parallel_make_valid<int, less<int>, 4>(valid, threads);
+				for (size_t i = 1; i < valid.size(); ++i)
+					if (valid[i] < valid[heap::interface<int, less<int>, 4>::parent_index(i)])
+						throw runtime_error("parallel_make_valid broke the heap property with " + to_string(threads) + " threads");
+
+				vector<int> expected = v;
+				heap::heap_sort(expected);
+				heap::parallel_heap_sort(v, threads);
+				expect_eq_vec(v, expected, "parallel_heap_sort with " + to_string(threads) + " threads");
+			}
+
+			//move-only elements without a default constructor
+			vector<unique_ptr<int>> pointers;
+			for (size_t i = 0; i < heap::parallel_threshold * 2 + 5; ++i)
+				pointers.push_back(make_unique<int>(dist(gen)));
+			vector<int> expected;
+			for (auto& pointer : pointers)
+				expected.push_back(*pointer);
+			heap::heap_sort(expected);
+			heap::parallel_heap_sort<unique_ptr<int>, unique_ptr_less>(pointers, 3);
+			vector<int> sorted;
+			for (auto& pointer : pointers)
+				sorted.push_back(*pointer);
+			expect_eq_vec(sorted, expected, "parallel_heap_sort of unique_ptr");
+		});
+
+	run("top_k: single pushes, batches and merged partial states", []()
+		{
+			mt19937 gen(17);
+			uniform_int_distribution<int> dist(-1000000, 1000000);
+			vector<int> stream(100003);
+			for (auto& item : stream)
+				item = dist(gen);
+
+			vector<int> largest = stream;
+			sort(largest.begin(), largest.end(), greater<int>());
+			largest.resize(100);
+
+			heap::top_k<int> single(100);
+			for (auto item : stream)
+				single.push(item);
+			expect_eq_vec(single.finish(), largest, "single pushes");
+
+			heap::top_k<int> first(100), second(100);
+			first.push(stream.data(), stream.data() + stream.size() / 2);
+			second.push(stream.begin() + stream.size() / 2, stream.end());
+			first.merge(second);
+			expect_eq_vec(first.finish(), largest, "merged batches");
+
+			vector<int> smallest = stream;
+			sort(smallest.begin(), smallest.end());
+			smallest.resize(7);
+			heap::top_k<int, greater<int>, 4> lowest(7);
+			lowest.push(stream);
+			expect_eq_vec(lowest.finish(), smallest, "top_k with greater keeps the smallest");
+
+			vector<float> floats = { 0.5f, -2.0f, 3.25f, 1.0f, 9.0f, -7.5f, 2.0f, 4.0f, 0.0f, 8.5f,
+				6.0f, -1.0f, 5.5f, 7.0f, 3.0f, 1.5f, 2.5f, -3.0f, 10.0f, 0.25f };
+			heap::top_k<float> top_floats(3);
+			top_floats.push(floats);
+			if (top_floats.finish() != vector<float>{ 10.0f, 9.0f, 8.5f })
+				throw runtime_error("float top_k result");
+
+			heap::top_k<int> none(0);
+			none.push(stream);
+			expect_eq_int(none.finish().size(), 0, "top_k with k = 0");
+		});
+
+	run("external_sort over multi-pass merges", []()
+		{
+			mt19937 gen(19);
+			vector<int> values(200000);
+			for (auto& item : values)
+				item = int(gen());
+
+			auto input = (filesystem::temp_directory_path() / "heap_tests_external_input.bin").string();
+			auto output = (filesystem::temp_directory_path() / "heap_tests_external_output.bin").string();
+			{
+				ofstream file(input, ios::binary);
+				file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(int));
+			}
+
+			auto stats = heap::external_sort<int>(input, output, 32 * 1024);
+			expect_eq_int(stats.runs, (values.size() * sizeof(int) + 32 * 1024 - 1) / (32 * 1024), "run count");
+			if (stats.passes < 3)
+				throw runtime_error("expected more than one merge pass, got " + to_string(stats.passes) + " passes");
+
+			vector<int> sorted(values.size());
+			{
+				ifstream file(output, ios::binary);
+				file.read(reinterpret_cast<char*>(sorted.data()), sorted.size() * sizeof(int));
+				expect_eq_int(size_t(file.gcount()), sorted.size() * sizeof(int), "output size");
+			}
+			sort(values.begin(), values.end());
+			expect_eq_vec(sorted, values, "external_sort result");
+			for (auto& entry : filesystem::directory_iterator(filesystem::temp_directory_path()))
+				if (entry.path().filename().string().rfind("heap_tests_external_output.bin.run", 0) == 0)
+					throw runtime_error("external_sort left the run file " + entry.path().string());
+
+			{
+				ofstream file(input, ios::binary | ios::app);
+				file.write("\x01\x02", 2);
+			}
+			auto threw = false;
+			try
+			{
+				heap::external_sort<int>(input, output, 32 * 1024);
+			}
+			catch (const runtime_error&)
+			{
+				threw = true;
+			}
+			if (!threw)
+				throw runtime_error("external_sort accepted an input ending with a partial element");
+
+			filesystem::remove(input);
+			filesystem::remove(output);
+		});
+
+	run("SIMD child selection matches the generic path", []()
+		{
+			struct plain_less
+			{
+				bool operator()(int left, int right) const { return left < right; }
+			};
+
+			mt19937 gen(23);
+			uniform_int_distribution<int> narrow(-3, 3);
+			uniform_int_distribution<int> wide(-1000000, 1000000);
+
+			for (int round = 0; round < 2000; ++round)
+			{
+				int children[8];
+				float float_children[8];
+				for (int i = 0; i < 8; ++i)
+				{
+					children[i] = round % 2 ? narrow(gen) : wide(gen);
+					float_children[i] = float(children[i]) / 4;
+				}
+
+				for (size_t count = 1; count <= 8; ++count)
+				{
+					expect_eq_int(heap::child_selector<int, less<int>, 8>::select(children, count),
+						heap::child_selector<int, plain_less, 8>::select(children, count), "int, less, 8 children");
+					expect_eq_int(heap::child_selector<int, greater<int>, 8>::select(children, count),
+						size_t(max_element(children, children + count) - children), "int, greater, 8 children");
+					expect_eq_int(heap::child_selector<float, less<float>, 8>::select(float_children, count),
+						size_t(min_element(float_children, float_children + count) - float_children), "float, less, 8 children");
+				}
+#ifdef HEAP_SIMD_X86
+				//every kernel the CPU can run, not only the dispatched one
+				using int_kernels = heap::simd::kernels<int, false, 8>;
+				auto expected = size_t(min_element(children, children + 8) - children);
+				expect_eq_int(int_kernels::scalar(children), expected, "scalar int kernel");
+				if (heap::simd::has_sse41())
+					expect_eq_int(int_kernels::sse41()(children), expected, "SSE4.1 int kernel");
+				if (heap::simd::has_avx2())
+					expect_eq_int(int_kernels::avx2()(children), expected, "AVX2 int kernel");
+#endif
+
+				for (size_t count = 1; count <= 4; ++count)
+				{
+					expect_eq_int(heap::child_selector<int, less<int>, 4>::select(children, count),
+						size_t(min_element(children, children + count) - children), "int, less, 4 children");
+					expect_eq_int(heap::child_selector<float, greater<float>, 4>::select(float_children, count),
+						size_t(max_element(float_children, float_children + count) - float_children), "float, greater, 4 children");
+				}
+			}
+
+			vector<int> v(100000);
+			for (auto& item : v)
+				item = narrow(gen) * 1000 + wide(gen) % 7;
+			vector<int> generic = v;
+			heap::heap_sort<int, less<int>, 8>(v);
+			heap::heap_sort<int, plain_less, 8>(generic);
+			expect_eq_vec(v, generic, "8-ary heap_sort with and without SIMD selection");
+
+			//a NaN in a sibling group must not leave the kernels without a selected child
+			struct plain_float_less
+			{
+				bool operator()(float left, float right) const { return left < right; }
+			};
+			vector<float> simd_heap, generic_heap;
+			for (int i = 0; i < 500; ++i)
+			{
+				auto value = i % 7 == 3 ? numeric_limits<float>::quiet_NaN() : float(wide(gen));
+				heap::interface<float, less<float>, 8>::insert(simd_heap, value);
+				heap::interface<float, plain_float_less, 8>::insert(generic_heap, value);
+			}
+			while (!simd_heap.empty())
+			{
+				auto simd_top = heap::interface<float, less<float>, 8>::remove(simd_heap);
+				auto generic_top = heap::interface<float, plain_float_less, 8>::remove(generic_heap);
+				if (memcmp(&simd_top, &generic_top, sizeof(float)) != 0)
+					throw runtime_error("8-ary float heap with NaN removes differently with SIMD selection");
+			}
+		});
+
+	run("radix_heap: monotone workload and Dijkstra", []()
+		{
+			mt19937 gen(31);
+			heap::radix_heap<unsigned, int> radix;
+			vector<unsigned> pending;
+			vector<unsigned> popped, expected;
+			unsigned low = 0;
+			for (int step = 0; step < 20000; ++step)
+			{
+				if (pending.empty() || gen() % 3 != 0)
+				{
+					//keys never drop below the last popped one, and repeat now and then
+					unsigned key = low + (gen() % 4 == 0 ? 0 : gen() % (1u << (gen() % 31)));
+					radix.enqueue(key, step);
+					pending.push_back(key);
+				}
+				else
+				{
+					auto smallest = min_element(pending.begin(), pending.end());
+					expected.push_back(*smallest);
+					pending.erase(smallest);
+					low = radix.dequeue().first;
+					popped.push_back(low);
+				}
+			}
+			expect_eq_int(radix.size(), pending.size(), "radix_heap size");
+			vector<int> popped_int(popped.begin(), popped.end()), expected_int(expected.begin(), expected.end());
+			expect_eq_vec(popped_int, expected_int, "radix_heap dequeue order");
+
+			if (low > 0)
+			{
+				bool thrown = false;
+				try
+				{
+					radix.enqueue(low - 1, 0);
+				}
+				catch (const invalid_argument&)
+				{
+					thrown = true;
+				}
+				if (!thrown)
+					throw runtime_error("enqueue below the last dequeued key did not throw");
+			}
+
+			//shortest paths on a random graph agree with priority_queue
+			const size_t vertices = 2000;
+			vector<vector<pair<size_t, unsigned>>> edges(vertices);
+			for (size_t from = 0; from < vertices; ++from)
+				for (int i = 0; i < 5; ++i)
+					edges[from].emplace_back(gen() % vertices, gen() % 1000);
+
+			const unsigned unreached = numeric_limits<unsigned>::max();
+			vector<unsigned> radix_distance(vertices, unreached), heap_distance(vertices, unreached);
+			heap::radix_heap<unsigned, size_t> radix_queue;
+			heap::priority_queue<unsigned, size_t> heap_queue;
+			radix_distance[0] = heap_distance[0] = 0;
+			radix_queue.enqueue(0, 0);
+			heap_queue.enqueue(0, 0);
+			while (!radix_queue.empty())
+			{
+				auto top = radix_queue.dequeue();
+				if (top.first != radix_distance[top.second])
+					continue;
+				for (auto& edge : edges[top.second])
+					if (top.first + edge.second < radix_distance[edge.first])
+						radix_queue.enqueue(radix_distance[edge.first] = top.first + edge.second, edge.first);
+			}
+			while (!heap_queue.empty())
+			{
+				auto top = heap_queue.dequeue();
+				if (top.first != heap_distance[top.second])
+					continue;
+				for (auto& edge : edges[top.second])
+					if (top.first + edge.second < heap_distance[edge.first])
+						heap_queue.enqueue(heap_distance[edge.first] = top.first + edge.second, edge.first);
+			}
+			for (size_t vertex = 0; vertex < vertices; ++vertex)
+				expect_eq_int(radix_distance[vertex], heap_distance[vertex], "Dijkstra distance");
+		});
+
+	run("min_max_heap: both ends, construction and bounded eviction", []()
+		{
+			mt19937 gen(37);
+			uniform_int_distribution<int> dist(-500, 500);
+
+			vector<int> data(1000);
+			for (auto& item : data)
+				item = dist(gen);
+			multiset<int> reference(data.begin(), data.end());
+			heap::min_max_heap<int> both{ data };
+
+			for (int step = 0; step < 20000; ++step)
+			{
+				if (reference.empty() || gen() % 3 == 0)
+				{
+					auto value = dist(gen);
+					both.insert(value);
+					reference.insert(value);
+				}
+				else if (gen() % 2 == 0)
+				{
+					expect_eq_int(size_t(both.pop_min() + 1000), size_t(*reference.begin() + 1000), "pop_min");
+					reference.erase(reference.begin());
+				}
+				else
+				{
+					expect_eq_int(size_t(both.pop_max() + 1000), size_t(*reference.rbegin() + 1000), "pop_max");
+					reference.erase(prev(reference.end()));
+				}
+
+				expect_eq_int(both.size(), reference.size(), "min_max_heap size");
+				if (!reference.empty())
+				{
+					expect_eq_int(size_t(both.min() + 1000), size_t(*reference.begin() + 1000), "min");
+					expect_eq_int(size_t(both.max() + 1000), size_t(*reference.rbegin() + 1000), "max");
+				}
+			}
+
+			//a bounded heap keeps the largest (evicting min) or the smallest (evicting max) elements seen
+			for (auto evicted : { heap::min_max_heap<int>::end::min, heap::min_max_heap<int>::end::max })
+			{
+				vector<int> initial(300), kept_data;
+				for (auto& item : initial)
+					item = dist(gen);
+				vector<int> seen = initial;
+				kept_data = initial;
+				heap::min_max_heap<int> bounded{ kept_data, 100, evicted };
+				expect_eq_int(bounded.size(), 100, "bounded construction trims to the capacity");
+
+				size_t evictions = 200;
+				for (int step = 0; step < 5000; ++step)
+				{
+					auto value = dist(gen);
+					seen.push_back(value);
+					evictions += bounded.insert(value).has_value();
+				}
+				expect_eq_int(evictions, seen.size() - 100, "one eviction per insert into a full heap");
+
+				sort(seen.begin(), seen.end());
+				vector<int> expected = evicted == heap::min_max_heap<int>::end::min ?
+					vector<int>(seen.end() - 100, seen.end()) : vector<int>(seen.begin(), seen.begin() + 100);
+				vector<int> drained;
+				while (!bounded.empty())
+					drained.push_back(bounded.pop_min());
+				expect_eq_vec(drained, expected, "bounded min_max_heap keeps the right end");
+			}
+
+			vector<int> none;
+			heap::min_max_heap<int> empty_heap{ none };
+			bool thrown = false;
+			try
+			{
+				empty_heap.max();
+			}
+			catch (const invalid_argument&)
+			{
+				thrown = true;
+			}
+			if (!thrown)
+				throw runtime_error("max() did not throw on empty");
+		});
+
+	run("priority_channel: batches, back-pressure, close and coroutines", []()
+		{
+			heap::priority_channel<int, int> ordered;
+			for (int key : { 5, 1, 4, 2, 3 })
+				ordered.enqueue(key, -key);
+			pair<int, int> item;
+			for (int key = 1; key <= 5; ++key)
+			{
+				if (!ordered.try_dequeue(item) || item.first != key || item.second != -key)
+					throw runtime_error("priority_channel does not dequeue by key");
+			}
+
+			heap::priority_channel<int, int> bounded(8);
+			atomic<bool> overflowed{ false };
+			thread producer([&]()
+				{
+					for (int batch = 0; batch < 100; ++batch)
+					{
+						vector<pair<int, int>> items;
+						for (int i = 0; i < 10; ++i)
+							items.emplace_back(batch * 10 + i, 0);
+						bounded.enqueue(items.begin(), items.end());
+					}
+					bounded.close();
+				});
+
+			vector<int> received;
+			pair<int, int> buffer[4];
+			while (auto taken = bounded.dequeue_n(buffer, 4))
+			{
+				if (bounded.size() > 8)
+					overflowed = true;
+				for (size_t i = 0; i < taken; ++i)
+					received.push_back(buffer[i].first);
+			}
+			producer.join();
+			if (overflowed)
+				throw runtime_error("priority_channel exceeded its capacity");
+			sort(received.begin(), received.end());
+			vector<int> expected(1000);
+			for (int i = 0; i < 1000; ++i)
+				expected[i] = i;
+			expect_eq_vec(received, expected, "every element passes the bounded channel once");
+
+			if (bounded.dequeue(item))
+				throw runtime_error("dequeue on a closed, drained channel returned an element");
+			bool thrown = false;
+			try
+			{
+				bounded.enqueue(1, 1);
+			}
+			catch (const runtime_error&)
+			{
+				thrown = true;
+			}
+			if (!thrown)
+				throw runtime_error("enqueue into a closed channel did not throw");
+
+			heap::priority_channel<int, int> full(2);
+			full.enqueue(1, 1);
+			full.enqueue(2, 2);
+			if (full.try_enqueue(3, 3))
+				throw runtime_error("try_enqueue succeeded on a full channel");
+
+#ifdef HEAP_CHANNEL_COROUTINES
+			heap::priority_channel<int, int> awaited;
+			vector<int> first_received, second_received;
+			bool first_finished = false, second_finished = false;
+			consume(awaited, first_received, first_finished);
+			consume(awaited, second_received, second_finished);
+
+			thread awaited_producer([&]()
+				{
+					vector<pair<int, int>> items;
+					for (int i = 0; i < 500; ++i)
+						items.emplace_back(i, 0);
+					awaited.enqueue(items.begin(), items.end());
+					for (int i = 500; i < 1000; ++i)
+						awaited.enqueue(i, 0);
+					awaited.close();
+				});
+			awaited_producer.join();
+
+			if (!first_finished || !second_finished)
+				throw runtime_error("a suspended consumer was not resumed on close");
+			first_received.insert(first_received.end(), second_received.begin(), second_received.end());
+			sort(first_received.begin(), first_received.end());
+			expect_eq_vec(first_received, expected, "every element reaches a suspended consumer once");
+#endif
+		});
+
+	run("persistent_heap: reopen, growth, dirty repair and checksum", []()
+		{
+			auto path = (filesystem::temp_directory_path() / "heap_tests_persistent.heap").string();
+			filesystem::remove(path);
+
+			mt19937 gen(41);
+			uniform_int_distribution<int> dist(-100000, 100000);
+			vector<int> values(5000);
+			for (auto& value : values)
+				value = dist(gen);
+
+			{
+				heap::persistent_heap<int> stored(path, heap::flush_policy::every_change);
+				for (size_t i = 0; i < 100; ++i)
+					stored.insert(values[i]);
+			}
+			{
+				//more elements than the initial capacity make the file grow and remap
+				heap::persistent_heap<int> stored(path);
+				expect_eq_int(stored.size(), 100, "persistent_heap count after reopen");
+				for (size_t i = 100; i < values.size(); ++i)
+					stored.insert(values[i]);
+			}
+
+			//breaks the heap order and marks the file as left by an interrupted change
+			{
+				fstream file(path, ios::in | ios::out | ios::binary);
+				heap::persistent_heap_header header;
+				file.read(reinterpret_cast<char*>(&header), sizeof(header));
+				expect_eq_int(header.count, values.size(), "persistent_heap header count");
+				int first, last;
+				file.seekg(sizeof(header));
+				file.read(reinterpret_cast<char*>(&first), sizeof(first));
+				file.seekg(sizeof(header) + (header.count - 1) * sizeof(int));
+				file.read(reinterpret_cast<char*>(&last), sizeof(last));
+				file.seekp(sizeof(header));
+				file.write(reinterpret_cast<char*>(&last), sizeof(last));
+				file.seekp(sizeof(header) + (header.count - 1) * sizeof(int));
+				file.write(reinterpret_cast<char*>(&first), sizeof(first));
+				header.dirty = 1;
+				file.seekp(0);
+				file.write(reinterpret_cast<char*>(&header), sizeof(header));
+			}
+			{
+				heap::persistent_heap<int> stored(path);
+				vector<int> drained;
+				while (!stored.empty())
+					drained.push_back(stored.remove());
+				vector<int> expected = values;
+				sort(expected.begin(), expected.end());
+				expect_eq_vec(drained, expected, "persistent_heap drains in order after repair");
+				stored.insert(7);
+			}
+
+			{
+				fstream file(path, ios::in | ios::out | ios::binary);
+				heap::persistent_heap_header header;
+				file.read(reinterpret_cast<char*>(&header), sizeof(header));
+				header.count = 2;
+				file.seekp(0);
+				file.write(reinterpret_cast<char*>(&header), sizeof(header));
+			}
+			bool thrown = false;
+			try
+			{
+				heap::persistent_heap<int> stored(path);
+			}
+			catch (const runtime_error&)
+			{
+				thrown = true;
+			}
+			filesystem::remove(path);
+			if (!thrown)
+				throw runtime_error("a header with a wrong checksum was accepted");
+		});
+
+	run("sequence_heap matches a sorted reference across group merges", []()
+		{
+			mt19937 gen(17);
+			heap::sequence_heap<int> sequence;
+			heap::sequence_heap<int, greater<int>> reversed;
+			multiset<int> reference;
+			vector<int> removed, expected;
+			//bursts of inserts and removes, so that insertion heap flushes meet a partly consumed delete buffer;
+			//more than 64 flushes also move group 0 into group 1
+			for (int burst = 0; burst < 400; ++burst)
+			{
+				auto inserts = gen() % 1000;
+				for (size_t index = 0; index < inserts; ++index)
+				{
+					int value = static_cast<int>(gen() % 100000);
+					sequence.insert(value);
+					reversed.insert(value);
+					reference.insert(value);
+				}
+				auto removes = min<size_t>(gen() % 800, reference.size());
+				for (size_t index = 0; index < removes; ++index)
+				{
+					removed.push_back(sequence.remove());
+					expected.push_back(*reference.begin());
+					reference.erase(reference.begin());
+				}
+			}
+			expect_eq_int(sequence.size(), reference.size(), "sequence_heap size");
+			while (!sequence.empty())
+			{
+				removed.push_back(sequence.remove());
+			}
+			expected.insert(expected.end(), reference.begin(), reference.end());
+			expect_eq_vec(removed, expected, "sequence_heap removal order");
+
+			vector<int> descending;
+			while (!reversed.empty())
+			{
+				descending.push_back(reversed.remove());
+			}
+			if (!is_sorted(descending.rbegin(), descending.rend()))
+			{
+				throw runtime_error("sequence_heap with greater<int> is not descending");
+			}
+
+			bool thrown = false;
+			try
+			{
+				sequence.remove();
+			}
+			catch (const invalid_argument&)
+			{
+				thrown = true;
+			}
+			if (!thrown)
+			{
+				throw runtime_error("sequence_heap remove on empty did not throw");
+			}
+		});
+
+	run("stable_storage: stable addresses, slot reuse and chunked allocation", []()
+		{
+			heap::stable_storage<int> storage;
+			vector<int*> addresses;
+			for (int value = 0; value < 1000; ++value)
+				addresses.push_back(&storage.emplace(value));
+			for (int value = 0; value < 1000; ++value)
+				if (*addresses[value] != value)
+					throw runtime_error("stable_storage moved an element");
+
+			auto capacity = storage.capacity();
+			storage.erase(*addresses[10]);
+			if (&storage.emplace(-1) != addresses[10] || storage.capacity() != capacity)
+				throw runtime_error("stable_storage did not reuse the erased slot");
+			expect_eq_int(storage.size(), 1000, "stable_storage size");
+
+			//removed elements give their slots back, so churn does not grow the storage
+			mt19937 gen(23);
+			heap::stable_storage<int> churn;
+			heap::heap_wrapper<int> wrapper{ churn };
+			for (int round = 0; round < 100; ++round)
+			{
+				for (int index = 0; index < 100; ++index)
+					wrapper.insert(static_cast<int>(gen() % 1000));
+				int last = -1;
+				while (!wrapper.empty())
+				{
+					auto value = wrapper.remove();
+					if (value < last)
+						throw runtime_error("heap_wrapper over stable_storage is out of order");
+					last = value;
+				}
+			}
+			expect_eq_int(churn.size(), 0, "stable_storage size after churn");
+			if (churn.capacity() > 128)
+				throw runtime_error("stable_storage grew although the slots were reused");
+
+#ifdef __cpp_lib_memory_resource
+			struct counting_resource : pmr::memory_resource
+			{
+				size_t allocations = 0;
+
+				void* do_allocate(size_t bytes, size_t alignment) override
+				{
+					allocations++;
+					return pmr::new_delete_resource()->allocate(bytes, alignment);
+				}
+				void do_deallocate(void* pointer, size_t bytes, size_t alignment) override
+				{
+					pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+				}
+				bool do_is_equal(const pmr::memory_resource& other) const noexcept override
+				{
+					return this == &other;
+				}
+			} resource;
+
+			heap::priority_queue<int, int, less<int>, 2, pmr::polymorphic_allocator<pair<int, int>>> queue(&resource);
+			for (int value = 0; value < 100000; ++value)
+				queue.enqueue(static_cast<int>(gen() % 100000), value);
+			//one allocation per chunk plus the growth of the chunk table, instead of one per element
+			if (resource.allocations > 32)
+				throw runtime_error("pmr priority_queue allocated " + to_string(resource.allocations) + " times");
+
+			int last = -1;
+			while (!queue.empty())
+			{
+				auto key = queue.dequeue().first;
+				if (key < last)
+					throw runtime_error("pmr priority_queue is out of order");
+				last = key;
+			}
+#endif
+		});
+
+	run("AVLTree: balance against std::set, erase by key, node reuse and heterogeneous lookup", []()
+		{
+			//recomputes the heights and checks order, parent links and the stored balance factors
+			AVLTree<int> tree;
+			function<int(AVLNode<int, void>*, const int*, const int*)> check = [&](AVLNode<int, void>* node, const int* low, const int* high)
+				{
+					if (node == nullptr)
+						return 0;
+					if ((low != nullptr && node->key <= *low) || (high != nullptr && node->key >= *high))
+						throw runtime_error("AVLTree is out of order");
+					for (auto child : { tree.left(node), tree.right(node) })
+						if (child != nullptr && tree.parent(child) != node)
+							throw runtime_error("AVLTree parent link is broken");
+					auto left = check(tree.left(node), low, &node->key);
+					auto right = check(tree.right(node), &node->key, high);
+					if (right - left != tree.balance_factor(node))
+						throw runtime_error("AVLTree balance factor is wrong");
+					return max(left, right) + 1;
+				};
+
+			mt19937 gen(29);
+			set<int> reference;
+			for (int step = 0; step < 20000; ++step)
+			{
+				int value = static_cast<int>(gen() % 2000);
+				if (gen() % 3 != 0)
+				{
+					if (tree.insert(value) != reference.insert(value).second)
+						throw runtime_error("AVLTree insert disagrees with std::set");
+				}
+				else if (tree.erase(value) != (reference.erase(value) != 0))
+					throw runtime_error("AVLTree erase disagrees with std::set");
+
+				if (step % 1000 == 0)
+				{
+					check(tree.root(), nullptr, nullptr);
+					if (tree.root() != nullptr && tree.parent(tree.root()) != nullptr)
+						throw runtime_error("AVLTree root has a parent");
+				}
+			}
+			check(tree.root(), nullptr, nullptr);
+			expect_eq_int(tree.size(), reference.size(), "AVLTree size");
+
+			vector<int> inorder;
+			for (auto node : tree)
+				inorder.push_back(node->key);
+			expect_eq_vec(inorder, vector<int>(reference.begin(), reference.end()), "AVLTree in-order traversal");
+
+			//erased nodes are reused, so churn at a constant size does not grow the arena
+			auto memory = tree.memory_usage();
+			for (int step = 0; step < 10000; ++step)
+			{
+				auto node = tree.root();
+				auto key = node->key;
+				tree.delete_node(node);
+				tree.insert(key);
+			}
+			expect_eq_int(tree.memory_usage(), memory, "AVLTree arena after churn");
+			tree.clear();
+			if (!tree.empty() || tree.root() != nullptr)
+				throw runtime_error("AVLTree clear left nodes behind");
+
+			AVLTree<string, int, less<>> map;
+			map.insert("beta", 2);
+			map.insert("alpha", 1);
+			if (map.insert("beta", 3))
+				throw runtime_error("AVLTree map accepted a duplicate key");
+			auto found = map.search(string_view("beta"));
+			if (found == nullptr || found->value != 2 || !map.contains("alpha") || map.contains(string_view("gamma")))
+				throw runtime_error("AVLTree heterogeneous lookup failed");
+			if (!map.erase(string_view("alpha")) || map.erase("alpha") || map.size() != 1)
+				throw runtime_error("AVLTree heterogeneous erase failed");
+
+			ostringstream drawn;
+			map.insert("gamma", 3);
+			map.draw(drawn);
+			if (drawn.str() != "Tree edges (parent -> child):\nbeta -> gamma\n")
+				throw runtime_error("AVLTree draw wrote " + drawn.str());
+		});
+
+	run("AVLTree: lazy iterators, reverse iteration and range scans against std::set", []()
+		{
+			mt19937 gen(31);
+			AVLTree<int> tree;
+			set<int> reference;
+			for (int step = 0; step < 5000; ++step)
+			{
+				int value = static_cast<int>(gen() % 10000);
+				tree.insert(value);
+				reference.insert(value);
+			}
+
+			vector<int> forward, backward;
+			for (auto node : tree)
+				forward.push_back(node->key);
+			for (auto it = tree.rbegin(); it != tree.rend(); ++it)
+				backward.push_back((*it)->key);
+			expect_eq_vec(forward, vector<int>(reference.begin(), reference.end()), "AVLTree forward iteration");
+			expect_eq_vec(backward, vector<int>(reference.rbegin(), reference.rend()), "AVLTree reverse iteration");
+
+			for (int probe = -1; probe <= 10001; probe += 7)
+			{
+				auto lower = tree.lower_bound(probe);
+				auto upper = tree.upper_bound(probe);
+				auto expected_lower = reference.lower_bound(probe);
+				auto expected_upper = reference.upper_bound(probe);
+				if ((lower == tree.end()) != (expected_lower == reference.end()) || (lower != tree.end() && lower->key != *expected_lower))
+					throw runtime_error("AVLTree lower_bound(" + to_string(probe) + ") is wrong");
+				if ((upper == tree.end()) != (expected_upper == reference.end()) || (upper != tree.end() && upper->key != *expected_upper))
+					throw runtime_error("AVLTree upper_bound(" + to_string(probe) + ") is wrong");
+				expect_eq_int(distance(tree.equal_range(probe).begin(), tree.equal_range(probe).end()), reference.count(probe), "AVLTree equal_range size");
+			}
+
+			for (int scan = 0; scan < 200; ++scan)
+			{
+				int low = static_cast<int>(gen() % 10000), high = low + static_cast<int>(gen() % 500);
+				vector<int> found;
+				for (auto node : tree.range(low, high))
+					found.push_back(node->key);
+				expect_eq_vec(found, vector<int>(reference.lower_bound(low), reference.lower_bound(high)), "AVLTree range scan");
+			}
+			if (!tree.range(20, 10).empty())
+				throw runtime_error("AVLTree range with low > high is not empty");
+
+			//an iterator keeps its position while other nodes are inserted and erased and the arena moves
+			auto it = tree.lower_bound(5000);
+			auto key = it->key;
+			for (int value = 10000; value < 30000; ++value)
+				tree.insert(value);
+			for (int value = 0; value < 4000; ++value)
+				tree.erase(value);
+			if (it->key != key || (++it)->key != *reference.upper_bound(key))
+				throw runtime_error("AVLTree iterator lost its position");
+			if ((--tree.end())->key != 29999)
+				throw runtime_error("AVLTree --end() is not the largest key");
+		});
+
+	run("AVLTree: select, rank and count against a sorted vector", []()
+		{
+			AVLTree<int> tree;
+			function<size_t(AVLNode<int, void>*)> check_sizes = [&](AVLNode<int, void>* node) -> size_t
+				{
+					if (node == nullptr)
+						return 0;
+					auto size = check_sizes(tree.left(node)) + check_sizes(tree.right(node)) + 1;
+					if (node->size != size)
+						throw runtime_error("AVLTree subtree size is wrong");
+					return size;
+				};
+
+			mt19937 gen(37);
+			vector<int> sorted;
+			for (int step = 0; step < 20000; ++step)
+			{
+				int value = static_cast<int>(gen() % 3000);
+				auto position = lower_bound(sorted.begin(), sorted.end(), value);
+				bool present = position != sorted.end() && *position == value;
+				if (gen() % 3 != 0)
+				{
+					tree.insert(value);
+					if (!present)
+						sorted.insert(position, value);
+				}
+				else
+				{
+					tree.erase(value);
+					if (present)
+						sorted.erase(position);
+				}
+
+				if (step % 500 == 0)
+				{
+					check_sizes(tree.root());
+					for (size_t k = 0; k < sorted.size(); k += 17)
+						if (tree.select(k)->key != sorted[k])
+							throw runtime_error("AVLTree select(" + to_string(k) + ") is wrong");
+					if (tree.select(sorted.size()) != tree.end())
+						throw runtime_error("AVLTree select past the end is not end()");
+					for (int probe = -1; probe <= 3001; probe += 13)
+					{
+						expect_eq_int(tree.rank(probe), lower_bound(sorted.begin(), sorted.end(), probe) - sorted.begin(), "AVLTree rank");
+						auto high = probe + static_cast<int>(gen() % 400);
+						expect_eq_int(tree.count(probe, high),
+							lower_bound(sorted.begin(), sorted.end(), high) - lower_bound(sorted.begin(), sorted.end(), probe), "AVLTree count");
+					}
+				}
+			}
+			check_sizes(tree.root());
+			expect_eq_int(tree.count(5, 5), 0, "AVLTree count of an empty interval");
+		});
+
+	run("AVLTree: from_sorted, split, join and parallel set operations against std algorithms", []()
+		{
+			//checks order, parent links, balance factors and subtree sizes; returns the height
+			function<int(AVLTree<int>&, AVLNode<int, void>*)> check = [&](AVLTree<int>& tree, AVLNode<int, void>* node)
+				{
+					if (node == nullptr)
+						return 0;
+					for (auto child : { tree.left(node), tree.right(node) })
+						if (child != nullptr && tree.parent(child) != node)
+							throw runtime_error("AVLTree parent link is broken");
+					if ((tree.left(node) != nullptr && tree.left(node)->key >= node->key) ||
+						(tree.right(node) != nullptr && tree.right(node)->key <= node->key))
+						throw runtime_error("AVLTree is out of order");
+					auto left = check(tree, tree.left(node));
+					auto right = check(tree, tree.right(node));
+					if (right - left != tree.balance_factor(node))
+						throw runtime_error("AVLTree balance factor is wrong");
+					if (node->size != (tree.left(node) ? tree.left(node)->size : 0) + (tree.right(node) ? tree.right(node)->size : 0) + 1)
+						throw runtime_error("AVLTree subtree size is wrong");
+					return max(left, right) + 1;
+				};
+			auto keys = [&](AVLTree<int>& tree)
+				{
+					check(tree, tree.root());
+					if (tree.root() != nullptr && tree.parent(tree.root()) != nullptr)
+						throw runtime_error("AVLTree root has a parent");
+					vector<int> result;
+					for (auto node : tree)
+						result.push_back(node->key);
+					expect_eq_int(result.size(), tree.size(), "AVLTree size");
+					return result;
+				};
+			mt19937 gen(41);
+			auto random_set = [&](size_t count, int range)
+				{
+					set<int> values;
+					while (values.size() < count)
+						values.insert(static_cast<int>(gen() % range));
+					return vector<int>(values.begin(), values.end());
+				};
+
+			for (size_t count : { 0, 1, 2, 3, 7, 100, 1000 })
+			{
+				auto sorted = random_set(count, 100000);
+				auto tree = AVLTree<int>::from_sorted(sorted.begin(), sorted.end());
+				expect_eq_vec(keys(tree), sorted, "AVLTree from_sorted");
+			}
+			try
+			{
+				vector<int> unsorted = { 1, 3, 3 };
+				AVLTree<int>::from_sorted(unsorted.begin(), unsorted.end());
+				throw runtime_error("from_sorted accepted a repeated key");
+			}
+			catch (const invalid_argument&)
+			{
+				// expected
+			}
+
+			//split at random keys, then join the halves back together
+			auto sorted = random_set(5000, 20000);
+			auto tree = AVLTree<int>::from_sorted(sorted.begin(), sorted.end());
+			for (int round = 0; round < 50; ++round)
+			{
+				int key = static_cast<int>(gen() % 21000) - 500;
+				auto greater = tree.split(key);
+				auto middle = lower_bound(sorted.begin(), sorted.end(), key);
+				expect_eq_vec(keys(tree), vector<int>(sorted.begin(), middle), "AVLTree split, lower part");
+				expect_eq_vec(keys(greater), vector<int>(middle, sorted.end()), "AVLTree split, upper part");
+				tree.join(move(greater));
+				if (!greater.empty())
+					throw runtime_error("AVLTree join left nodes in the joined tree");
+				expect_eq_vec(keys(tree), sorted, "AVLTree join");
+			}
+			//the slots split off and joined back are reused instead of growing the arena
+			auto memory = tree.memory_usage();
+			auto upper = tree.split(10000);
+			for (int value = 10000; value < 10100; ++value)
+				tree.insert(value);
+			if (tree.memory_usage() != memory)
+				throw runtime_error("AVLTree split did not free its slots");
+			try
+			{
+				auto low = AVLTree<int>::from_sorted(sorted.begin(), sorted.end());
+				tree.join(move(low));
+				throw runtime_error("AVLTree join accepted overlapping keys");
+			}
+			catch (const invalid_argument&)
+			{
+				// expected
+			}
+
+			//large enough for the bulk operations to fork
+			for (auto sizes : { make_pair(size_t(0), size_t(10)), make_pair(size_t(10), size_t(0)), make_pair(size_t(300), size_t(50)),
+				make_pair(size_t(60000), size_t(40000)) })
+			{
+				auto first_keys = random_set(sizes.first, 150000);
+				auto second_keys = random_set(sizes.second, 150000);
+				auto first = AVLTree<int>::from_sorted(first_keys.begin(), first_keys.end());
+				AVLTree<int> second;
+				for (auto key : second_keys)
+					second.insert(key);
+
+				vector<int> expected;
+				std::set_union(first_keys.begin(), first_keys.end(), second_keys.begin(), second_keys.end(), back_inserter(expected));
+				auto united = AVLTree<int>::set_union(first, second, 4);
+				expect_eq_vec(keys(united), expected, "AVLTree set_union");
+
+				expected.clear();
+				std::set_intersection(first_keys.begin(), first_keys.end(), second_keys.begin(), second_keys.end(), back_inserter(expected));
+				auto common = AVLTree<int>::set_intersection(first, second, 4);
+				expect_eq_vec(keys(common), expected, "AVLTree set_intersection");
+
+				expected.clear();
+				std::set_difference(first_keys.begin(), first_keys.end(), second_keys.begin(), second_keys.end(), back_inserter(expected));
+				auto difference = AVLTree<int>::set_difference(first, second, 4);
+				expect_eq_vec(keys(difference), expected, "AVLTree set_difference");
+
+				//the dropped nodes are free slots of the result
+				auto capacity = common.memory_usage();
+				for (auto key : second_keys)
+					common.insert(key);
+				if (common.memory_usage() != capacity)
+					throw runtime_error("AVLTree set_intersection did not free the dropped nodes");
+				expect_eq_vec(keys(first), first_keys, "AVLTree operand after the set operations");
+			}
+
+			AVLTree<string, int> first_map, second_map;
+			first_map.insert("shared", 1);
+			second_map.insert("shared", 2);
+			second_map.insert("other", 3);
+			auto merged = AVLTree<string, int>::set_union(first_map, second_map);
+			if (merged.size() != 2 || merged.search("shared")->value != 1)
+				throw runtime_error("AVLTree set_union did not keep the value of the first map");
+		});
+
+	run("FrozenAVLTree: eytzinger and block layouts against std::lower_bound", []()
+		{
+			mt19937 gen(43);
+			auto check = [](const auto& frozen, const vector<int>& sorted, const string& name)
+				{
+					expect_eq_int(frozen.size(), sorted.size(), name + " size");
+					int low = sorted.empty() ? 0 : sorted.front() - 2, high = sorted.empty() ? 0 : sorted.back() + 2;
+					for (int probe = low; probe <= high; ++probe)
+					{
+						auto expected = std::lower_bound(sorted.begin(), sorted.end(), probe);
+						auto found = frozen.lower_bound(probe);
+						if ((found == nullptr) != (expected == sorted.end()) || (found != nullptr && *found != *expected))
+							throw runtime_error(name + " lower_bound(" + to_string(probe) + ") is wrong");
+						if (frozen.contains(probe) != (expected != sorted.end() && *expected == probe))
+							throw runtime_error(name + " contains(" + to_string(probe) + ") is wrong");
+					}
+				};
+
+			//sizes around a block of 16 and a full eytzinger level of 15
+			for (size_t count : { 0, 1, 2, 15, 16, 17, 255, 256, 1000, 5000 })
+			{
+				AVLTree<int> tree;
+				while (tree.size() < count)
+					tree.insert(static_cast<int>(gen() % (count * 4 + 1)) - static_cast<int>(count));
+				vector<int> sorted;
+				for (auto node : tree)
+					sorted.push_back(node->key);
+				check(tree.freeze(), sorted, "eytzinger of " + to_string(count));
+				check(tree.freeze<FrozenLayout::blocks>(), sorted, "blocks of " + to_string(count));
+				expect_eq_int(tree.size(), count, "AVLTree size after freeze");
+			}
+
+			AVLTree<int, string> map;
+			for (int key = 0; key < 300; key += 3)
+				map.insert(key, to_string(key));
+			auto frozen_map = map.freeze<FrozenLayout::blocks>();
+			for (int key = 0; key < 300; ++key)
+			{
+				auto value = frozen_map.search(key);
+				if ((value != nullptr) != (key % 3 == 0) || (value != nullptr && *value != to_string(key)))
+					throw runtime_error("FrozenAVLTree map search(" + to_string(key) + ") is wrong");
+			}
+
+			//string keys take the portable block ranking
+			vector<string> words = { "apple", "banana", "cherry", "date", "fig", "grape", "kiwi", "lemon", "mango",
+				"nectarine", "orange", "papaya", "pear", "plum", "quince", "raspberry", "strawberry", "tangerine" };
+			auto frozen_words = FrozenAVLTree<string, void, less<string>, FrozenLayout::blocks>::from_sorted(words.begin(), words.end());
+			if (!frozen_words.contains("plum") || frozen_words.contains("peach") || *frozen_words.lower_bound("peach") != "pear"
+				|| frozen_words.lower_bound("zucchini") != nullptr)
+				throw runtime_error("FrozenAVLTree of strings is wrong");
+
+			bool thrown = false;
+			try
+			{
+				vector<int> unsorted = { 1, 3, 2 };
+				FrozenAVLTree<int>::from_sorted(unsorted.begin(), unsorted.end());
+			}
+			catch (const invalid_argument&)
+			{
+				thrown = true;
+			}
+			if (!thrown)
+				throw runtime_error("FrozenAVLTree::from_sorted accepted unsorted keys");
+		});
+
+	run("ConcurrentAVLTree: writers on disjoint keys while readers see the stable keys", []()
+		{
+			ConcurrentAVLTree<int> tree;
+			constexpr int writers = 4, owned = 2000, stable = 1000;
+			//keys from writers * owned up are inserted before the threads start and never erased
+			for (int key = 0; key < stable; ++key)
+				tree.insert(writers * owned + key * 7);
+
+			atomic<bool> done{ false };
+			atomic<int> errors{ 0 };
+			vector<set<int>> expected(writers);
+			vector<thread> threads;
+			for (int t = 0; t < writers; ++t)
+			{
+				threads.emplace_back([&, t]()
+					{
+						mt19937 gen(43 + t);
+						for (int step = 0; step < 30000; ++step)
+						{
+							//writer t owns the keys that are t modulo writers
+							int key = static_cast<int>(gen() % owned) * writers + t;
+							if (gen() % 2 == 0)
+							{
+								if (tree.insert(key) != expected[t].insert(key).second)
+									errors++;
+							}
+							else if (tree.erase(key) != (expected[t].erase(key) != 0))
+								errors++;
+							if (tree.contains(key) != (expected[t].count(key) != 0))
+								errors++;
+						}
+					});
+			}
+			for (int t = 0; t < 2; ++t)
+			{
+				threads.emplace_back([&, t]()
+					{
+						mt19937 gen(53 + t);
+						while (!done.load())
+						{
+							if (!tree.contains(writers * owned + static_cast<int>(gen() % stable) * 7))
+								errors++;
+							if (tree.contains(writers * owned + static_cast<int>(gen() % stable) * 7 + 1))
+								errors++;
+						}
+					});
+			}
+			for (int t = 0; t < writers; ++t)
+				threads[t].join();
+			done = true;
+			for (size_t t = writers; t < threads.size(); ++t)
+				threads[t].join();
+			expect_eq_int(errors.load(), 0, "ConcurrentAVLTree operations that disagreed with the expected sets");
+
+			size_t total = stable;
+			for (int t = 0; t < writers; ++t)
+			{
+				total += expected[t].size();
+				for (int index = 0; index < owned; ++index)
+				{
+					int key = index * writers + t;
+					if (tree.contains(key) != (expected[t].count(key) != 0))
+						throw runtime_error("ConcurrentAVLTree lost or kept key " + to_string(key));
+				}
+			}
+			expect_eq_int(tree.size(), total, "ConcurrentAVLTree size");
+			//routing nodes may remain, so the bound is that of an AVL tree over every key ever inserted
+			if (tree.height() > 1.45 * log2(writers * owned + stable + 2))
+				throw runtime_error("ConcurrentAVLTree is not balanced: height " + to_string(tree.height()));
+		});
+
 	run("remove throws on empty", []()
 		{
 			vector<int> v;
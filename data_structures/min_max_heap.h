@@ -0,0 +1,261 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace heap
+{
+	//double-ended heap over the caller's vector, like heap::heap. Even levels are ordered towards the element that
+	//comes first in comp order (min), odd levels towards the one that comes last (max), so both ends sit in the first
+	//three slots. With a capacity, insert into a full heap evicts from the chosen end instead of growing
+	template<typename T, typename comp = std::less<T>>
+	class min_max_heap
+	{
+	public:
+		enum class end { min, max };
+		static constexpr size_t unbounded = std::numeric_limits<size_t>::max();
+
+	private:
+		static constexpr comp precede = comp{};
+
+		std::vector<T>& data;
+		size_t limit;
+		end evicted;
+
+		static bool is_min_level(size_t index)
+		{
+			size_t level = 0;
+			for (auto position = index + 1; position > 1; position >>= 1)
+			{
+				level++;
+			}
+			return level % 2 == 0;
+		}
+		//on a max level the order is reversed
+		template<bool max_level>
+		static bool before(const T& left, const T& right)
+		{
+			return max_level ? precede(right, left) : precede(left, right);
+		}
+
+		template<bool max_level>
+		void push_down(size_t index)
+		{
+			while (2 * index + 1 < data.size())
+			{
+				//the best of the children and grandchildren
+				auto best = 2 * index + 1;
+				auto last = std::min(4 * index + 6, data.size() - 1);
+				for (auto candidate = best + 1; candidate <= last; candidate = candidate == 2 * index + 2 ? 4 * index + 3 : candidate + 1)
+				{
+					if (before<max_level>(data[candidate], data[best]))
+					{
+						best = candidate;
+					}
+				}
+
+				if (!before<max_level>(data[best], data[index]))
+				{
+					return;
+				}
+				std::swap(data[best], data[index]);
+
+				if (best <= 2 * index + 2)
+				{
+					return;
+				}
+				//a grandchild moved down past its parent, which is on the opposite kind of level
+				auto parent = (best - 1) / 2;
+				if (before<max_level>(data[parent], data[best]))
+				{
+					std::swap(data[parent], data[best]);
+				}
+				index = best;
+			}
+		}
+		void push_down(size_t index)
+		{
+			if (is_min_level(index))
+			{
+				push_down<false>(index);
+			}
+			else
+			{
+				push_down<true>(index);
+			}
+		}
+		template<bool max_level>
+		void push_up_levels(size_t index)
+		{
+			while (index > 2)
+			{
+				auto grandparent = ((index - 1) / 2 - 1) / 2;
+				if (!before<max_level>(data[index], data[grandparent]))
+				{
+					return;
+				}
+				std::swap(data[index], data[grandparent]);
+				index = grandparent;
+			}
+		}
+		void push_up(size_t index)
+		{
+			if (index == 0)
+			{
+				return;
+			}
+
+			auto parent = (index - 1) / 2;
+			if (is_min_level(index))
+			{
+				if (precede(data[parent], data[index]))
+				{
+					std::swap(data[parent], data[index]);
+					push_up_levels<true>(parent);
+				}
+				else
+				{
+					push_up_levels<false>(index);
+				}
+			}
+			else
+			{
+				if (precede(data[index], data[parent]))
+				{
+					std::swap(data[parent], data[index]);
+					push_up_levels<false>(parent);
+				}
+				else
+				{
+					push_up_levels<true>(index);
+				}
+			}
+		}
+		size_t max_index() const
+		{
+			if (data.size() < 3)
+			{
+				return data.size() - 1;
+			}
+			return precede(data[1], data[2]) ? 2 : 1;
+		}
+		T pop_at(size_t index)
+		{
+			auto result = std::move(data[index]);
+			if (index + 1 != data.size())
+			{
+				data[index] = std::move(data.back());
+				data.pop_back();
+				push_down(index);
+			}
+			else
+			{
+				data.pop_back();
+			}
+			return result;
+		}
+		void check_not_empty() const
+		{
+			if (data.empty())
+			{
+				throw std::invalid_argument{ "The data is empty" };
+			}
+		}
+
+		template<typename U>
+		std::optional<T> insert_value(U&& value)
+		{
+			if (data.size() < limit)
+			{
+				data.push_back(std::forward<U>(value));
+				push_up(data.size() - 1);
+				return std::nullopt;
+			}
+			if (limit == 0)
+			{
+				return T(std::forward<U>(value));
+			}
+
+			//the new element replaces the evicted end unless it would be evicted itself
+			auto index = evicted == end::min ? 0 : max_index();
+			if (evicted == end::min ? !precede(data[index], value) : !precede(value, data[index]))
+			{
+				return T(std::forward<U>(value));
+			}
+
+			std::optional<T> result{ std::move(data[index]) };
+			data[index] = std::forward<U>(value);
+			if (index != 0 && precede(data[index], data[0]))
+			{
+				//a replaced max may come before the min at the root
+				std::swap(data[index], data[0]);
+			}
+			push_down(index);
+			return result;
+		}
+
+	public:
+		//arranges data in O(n); with a capacity below its size the surplus is evicted from the chosen end
+		min_max_heap(std::vector<T>& data, size_t capacity = unbounded, end evicted = end::min)
+			: data(data), limit(capacity), evicted(evicted)
+		{
+			for (auto index = data.size() / 2; index > 0; index--)
+			{
+				push_down(index - 1);
+			}
+			while (data.size() > limit)
+			{
+				evicted == end::min ? pop_min() : pop_max();
+			}
+		}
+
+		const T& min() const
+		{
+			check_not_empty();
+			return data[0];
+		}
+		const T& max() const
+		{
+			check_not_empty();
+			return data[max_index()];
+		}
+		T pop_min()
+		{
+			check_not_empty();
+			return pop_at(0);
+		}
+		T pop_max()
+		{
+			check_not_empty();
+			return pop_at(max_index());
+		}
+
+		//returns the element evicted to stay within the capacity, which may be value itself
+		std::optional<T> insert(const T& value)
+		{
+			return insert_value(value);
+		}
+		std::optional<T> insert(T&& value)
+		{
+			return insert_value(std::move(value));
+		}
+
+		bool empty() const
+		{
+			return data.empty();
+		}
+		size_t size() const
+		{
+			return data.size();
+		}
+		size_t capacity() const
+		{
+			return limit;
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "heap.h"
+
+namespace heap
+{
+	//relaxed concurrent priority queue: elements are spread over relaxation * threads heaps guarded by
+	//their own mutexes. dequeue looks at two random heaps and takes the preceding top, so it returns an
+	//element close to, but not necessarily exactly at, the top of the whole queue
+	template<typename T, typename comp = std::less<T>, size_t arity = 2>
+	class multi_queue
+	{
+	private:
+		using interface = ::heap::interface<T, comp, arity>;
+		static constexpr comp precede = comp{};
+
+		//each shard gets its own cache lines so that locking one does not slow down its neighbours
+		struct alignas(64) shard
+		{
+			std::mutex lock;
+			std::vector<T> data;
+			std::atomic<size_t> size{ 0 };
+		};
+
+		std::unique_ptr<shard[]> shards;
+		size_t shards_count;
+
+		static std::minstd_rand& generator()
+		{
+			thread_local std::minstd_rand gen(static_cast<unsigned>(std::hash<std::thread::id>{}(std::this_thread::get_id())));
+			return gen;
+		}
+		size_t random_shard()
+		{
+			return generator()() % shards_count;
+		}
+
+		//locks a shard for insertion, probing random shards until one is free
+		shard& lock_any()
+		{
+			while (true)
+			{
+				auto& target = shards[random_shard()];
+				if (target.lock.try_lock())
+				{
+					return target;
+				}
+			}
+		}
+		//power-of-two-choices: locks two random shards and keeps the one with the preceding top.
+		//Returns nullptr if neither could be locked or both were empty
+		shard* lock_best()
+		{
+			auto& first = shards[random_shard()];
+			auto& second = shards[random_shard()];
+
+			auto first_locked = first.lock.try_lock();
+			auto second_locked = &first != &second && second.lock.try_lock();
+
+			shard* best = nullptr;
+			if (first_locked && !first.data.empty())
+			{
+				best = &first;
+			}
+			if (second_locked && !second.data.empty() &&
+				(best == nullptr || precede(second.data[0], best->data[0])))
+			{
+				best = &second;
+			}
+
+			if (first_locked && best != &first)
+			{
+				first.lock.unlock();
+			}
+			if (second_locked && best != &second)
+			{
+				second.lock.unlock();
+			}
+
+			return best;
+		}
+
+	public:
+		//relaxation is the number of heaps per thread; larger values lower contention and raise the rank error
+		multi_queue(size_t threads = std::thread::hardware_concurrency(), size_t relaxation = 2)
+			: shards_count(std::max<size_t>(threads, 1) * std::max<size_t>(relaxation, 1))
+		{
+			shards.reset(new shard[shards_count]);
+		}
+		multi_queue(const multi_queue&) = delete;
+		multi_queue& operator=(const multi_queue&) = delete;
+
+		void enqueue(const T& value)
+		{
+			auto& target = lock_any();
+			interface::insert(target.data, value);
+			target.size.store(target.data.size(), std::memory_order_relaxed);
+			target.lock.unlock();
+		}
+		void enqueue(T&& value)
+		{
+			auto& target = lock_any();
+			interface::insert(target.data, std::move(value));
+			target.size.store(target.data.size(), std::memory_order_relaxed);
+			target.lock.unlock();
+		}
+		//inserts the whole range into one heap under a single lock
+		template<typename Iterator>
+		void enqueue(Iterator first, Iterator last)
+		{
+			auto& target = lock_any();
+			for (; first != last; ++first)
+			{
+				interface::insert(target.data, *first);
+			}
+			target.size.store(target.data.size(), std::memory_order_relaxed);
+			target.lock.unlock();
+		}
+
+		//returns false only if every heap was seen empty
+		bool try_dequeue(T& value)
+		{
+			return dequeue(&value, 1) == 1;
+		}
+		//writes up to count elements taken from the top of one heap, returns how many were written
+		template<typename Iterator>
+		size_t dequeue(Iterator out, size_t count)
+		{
+			if (count == 0)
+			{
+				return 0;
+			}
+
+			while (true)
+			{
+				auto target = lock_best();
+
+				if (target == nullptr)
+				{
+					if (empty())
+					{
+						return 0;
+					}
+					std::this_thread::yield();
+					continue;
+				}
+
+				size_t taken = 0;
+				for (; taken < count && !target->data.empty(); ++taken)
+				{
+					*out = interface::remove(target->data);
+					++out;
+				}
+				target->size.store(target->data.size(), std::memory_order_relaxed);
+				target->lock.unlock();
+
+				return taken;
+			}
+		}
+
+		//both are snapshots and may be outdated as soon as they return while other threads run
+		bool empty() const
+		{
+			return size() == 0;
+		}
+		size_t size() const
+		{
+			size_t total = 0;
+			for (size_t index = 0; index < shards_count; index++)
+			{
+				total += shards[index].size.load(std::memory_order_relaxed);
+			}
+			return total;
+		}
+	};
+}
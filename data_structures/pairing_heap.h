@@ -0,0 +1,316 @@
+#pragma once
+
+#include <algorithm>
+#include <forward_list>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace heap
+{
+	//meldable heap with the insert/replace_top/remove/empty interface of heap::heap.
+	//insert and merge are O(1), remove is O(log n) amortized. Nodes are carved out of chunks owned by
+	//the heap, so merging splices the chunk lists instead of moving elements
+	template<typename T, typename comp = std::less<T>>
+	class pairing_heap
+	{
+	private:
+		static constexpr comp precede = comp{};
+		static constexpr size_t min_chunk_size = 64;
+
+		//value is constructed only while the node is part of the heap; free nodes are chained through next
+		struct node
+		{
+			node* child;
+			node* next;
+			alignas(T) unsigned char storage[sizeof(T)];
+
+			T& value()
+			{
+				return *std::launder(reinterpret_cast<T*>(storage));
+			}
+		};
+
+		std::forward_list<std::unique_ptr<node[]>> chunks;
+		node* chunk_next = nullptr;
+		node* chunk_end = nullptr;
+		node* free_nodes = nullptr;
+		node* free_tail = nullptr;
+		node* root = nullptr;
+		size_t count = 0;
+		size_t reserved = 0;
+
+		void reserve_chunk(size_t capacity)
+		{
+			chunks.emplace_front(new node[capacity]);
+			chunk_next = chunks.front().get();
+			chunk_end = chunk_next + capacity;
+			reserved += capacity;
+		}
+		template<typename... Args>
+		node* create(Args&&... args)
+		{
+			node* result;
+			if (free_nodes != nullptr)
+			{
+				result = free_nodes;
+				free_nodes = free_nodes->next;
+				if (free_nodes == nullptr)
+				{
+					free_tail = nullptr;
+				}
+			}
+			else
+			{
+				if (chunk_next == chunk_end)
+				{
+					reserve_chunk(std::max(min_chunk_size, count));
+				}
+				result = chunk_next++;
+			}
+
+			new (result->storage) T(std::forward<Args>(args)...);
+			result->child = nullptr;
+			result->next = nullptr;
+			return result;
+		}
+		void release(node* target)
+		{
+			target->value().~T();
+			target->next = free_nodes;
+			free_nodes = target;
+			if (free_tail == nullptr)
+			{
+				free_tail = target;
+			}
+		}
+
+		//the root that does not precede becomes the first child of the other one
+		static node* link(node* first, node* second)
+		{
+			if (precede(second->value(), first->value()))
+			{
+				std::swap(first, second);
+			}
+
+			second->next = first->child;
+			first->child = second;
+			first->next = nullptr;
+			return first;
+		}
+		//two-pass pairing: link siblings pairwise left to right, then fold the pairs right to left
+		static node* merge_siblings(node* first)
+		{
+			node* pairs = nullptr;
+			while (first != nullptr)
+			{
+				auto second = first->next;
+				if (second == nullptr)
+				{
+					first->next = pairs;
+					pairs = first;
+					break;
+				}
+
+				auto rest = second->next;
+				auto linked = link(first, second);
+				linked->next = pairs;
+				pairs = linked;
+				first = rest;
+			}
+
+			node* result = nullptr;
+			while (pairs != nullptr)
+			{
+				auto rest = pairs->next;
+				pairs->next = nullptr;
+				result = result == nullptr ? pairs : link(result, pairs);
+				pairs = rest;
+			}
+			return result;
+		}
+		void insert_node(node* target)
+		{
+			root = root == nullptr ? target : link(root, target);
+			count++;
+		}
+
+		void destroy_values()
+		{
+			if (std::is_trivially_destructible<T>::value)
+			{
+				return;
+			}
+
+			//flattens the tree into the sibling chain of root while destroying it
+			auto current = root;
+			while (current != nullptr)
+			{
+				if (current->child != nullptr)
+				{
+					auto last = current->child;
+					while (last->next != nullptr)
+					{
+						last = last->next;
+					}
+					last->next = current->next;
+					current->next = current->child;
+					current->child = nullptr;
+				}
+
+				auto next = current->next;
+				current->value().~T();
+				current = next;
+			}
+		}
+
+	public:
+		pairing_heap() = default;
+		pairing_heap(pairing_heap&& other) noexcept
+		{
+			swap(other);
+		}
+		pairing_heap& operator=(pairing_heap&& other) noexcept
+		{
+			swap(other);
+			return *this;
+		}
+		pairing_heap(const pairing_heap&) = delete;
+		pairing_heap& operator=(const pairing_heap&) = delete;
+		~pairing_heap()
+		{
+			destroy_values();
+		}
+
+		void swap(pairing_heap& other) noexcept
+		{
+			chunks.swap(other.chunks);
+			std::swap(chunk_next, other.chunk_next);
+			std::swap(chunk_end, other.chunk_end);
+			std::swap(free_nodes, other.free_nodes);
+			std::swap(free_tail, other.free_tail);
+			std::swap(root, other.root);
+			std::swap(count, other.count);
+			std::swap(reserved, other.reserved);
+		}
+
+		void insert(const T& value)
+		{
+			insert_node(create(value));
+		}
+		void insert(T&& value)
+		{
+			insert_node(create(std::move(value)));
+		}
+		template<typename... Args>
+		void emplace(Args&&... args)
+		{
+			insert_node(create(std::forward<Args>(args)...));
+		}
+		//fills the free nodes and the rest of the current chunk, then reserves one chunk for what is left
+		//of the range, and links every element to the root. An input range can be read only once, so it
+		//grows chunk by chunk like insert
+		template<typename Iterator>
+		void bulk_insert(Iterator first, Iterator last)
+		{
+			using category = typename std::iterator_traits<Iterator>::iterator_category;
+			if constexpr (!std::is_base_of<std::forward_iterator_tag, category>::value)
+			{
+				for (; first != last; ++first)
+				{
+					insert(*first);
+				}
+				return;
+			}
+
+			auto remaining = static_cast<size_t>(std::distance(first, last));
+			for (; remaining != 0 && (free_nodes != nullptr || chunk_next != chunk_end); remaining--, ++first)
+			{
+				insert(*first);
+			}
+			if (remaining != 0)
+			{
+				reserve_chunk(std::max(min_chunk_size, remaining));
+			}
+
+			for (; first != last; ++first)
+			{
+				insert(*first);
+			}
+		}
+		//takes over every element and node of other in O(1); the unused tail of other's newest chunk is not reused
+		void merge(pairing_heap& other)
+		{
+			if (&other == this || other.root == nullptr)
+			{
+				return;
+			}
+
+			root = root == nullptr ? other.root : link(root, other.root);
+			count += other.count;
+			reserved += other.reserved;
+			chunks.splice_after(chunks.before_begin(), other.chunks);
+
+			if (other.free_nodes != nullptr)
+			{
+				other.free_tail->next = free_nodes;
+				if (free_nodes == nullptr)
+				{
+					free_tail = other.free_tail;
+				}
+				free_nodes = other.free_nodes;
+			}
+
+			other.chunk_next = other.chunk_end = nullptr;
+			other.free_nodes = other.free_tail = nullptr;
+			other.root = nullptr;
+			other.count = other.reserved = 0;
+		}
+
+		void replace_top(const T& value)
+		{
+			replace_top(T(value));
+		}
+		void replace_top(T&& value)
+		{
+			if (root != nullptr)
+			{
+				remove();
+			}
+			insert(std::move(value));
+		}
+		T remove()
+		{
+			if (root == nullptr)
+			{
+				throw std::invalid_argument{ "The data is empty" };
+			}
+
+			auto removed = root;
+			auto result = std::move(removed->value());
+			root = merge_siblings(removed->child);
+			count--;
+			release(removed);
+
+			return result;
+		}
+
+		bool empty()
+		{
+			return root == nullptr;
+		}
+		size_t size()
+		{
+			return count;
+		}
+		//nodes allocated so far, in use or free
+		size_t capacity()
+		{
+			return reserved;
+		}
+	};
+}
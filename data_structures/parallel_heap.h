@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "heap.h"
+
+namespace heap
+{
+	//below this size the sequential routines are faster than starting threads
+	constexpr size_t parallel_threshold = size_t{ 1 } << 15;
+
+	//runs task(0..threads-1), task(0) on the calling thread
+	template<typename F>
+	void run_parallel(size_t threads, F&& task)
+	{
+		std::vector<std::thread> workers;
+		workers.reserve(threads - 1);
+		for (size_t index = 1; index < threads; index++)
+		{
+			workers.emplace_back(task, index);
+		}
+		task(0);
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	//Floyd's construction split by subtrees: the subtrees rooted at one level of the heap do not
+	//overlap, so every thread heapifies its own share of them; the levels above are fixed afterwards
+	template<typename T, typename comp = std::less<T>, size_t arity = 2>
+	void parallel_make_valid(std::vector<T>& data, size_t threads = std::thread::hardware_concurrency())
+	{
+		using interface = ::heap::interface<T, comp, arity>;
+
+		threads = std::max<size_t>(threads, 1);
+		if (threads == 1 || data.size() < parallel_threshold)
+		{
+			interface::make_valid(data);
+			return;
+		}
+
+		//first index of the shallowest level that has at least 4 subtrees per thread
+		size_t level_start = 0, level_width = 1;
+		while (level_width < 4 * threads)
+		{
+			level_start = interface::left_index(level_start);
+			level_width *= arity;
+		}
+		if (level_start >= data.size())
+		{
+			interface::make_valid(data);
+			return;
+		}
+		auto level_end = std::min(level_start + level_width, data.size());
+
+		run_parallel(threads, [&](size_t thread)
+			{
+				auto share = (level_end - level_start + threads - 1) / threads;
+				auto first_root = std::min(level_start + thread * share, level_end);
+				auto last_root = std::min(first_root + share, level_end);
+
+				//the descendants of a root on one level form a contiguous range; one buffer serves every root
+				std::vector<std::pair<size_t, size_t>> levels;
+				for (auto root = first_root; root < last_root; root++)
+				{
+					levels.clear();
+					for (auto first = root, last = root + 1; first < data.size();
+						first = interface::left_index(first), last = interface::right_index(last - 1) + 1)
+					{
+						levels.emplace_back(first, std::min(last, data.size()));
+					}
+
+					for (auto level = levels.rbegin(); level != levels.rend(); ++level)
+					{
+						for (auto index = level->second; index > level->first; index--)
+						{
+							interface::bubble_down(data, index - 1, data.size());
+						}
+					}
+				}
+			});
+
+		for (auto index = level_start; index > 0; index--)
+		{
+			interface::bubble_down(data, index - 1, data.size());
+		}
+	}
+
+	//sorts into the same order as heap_sort: threads heap_sort their own chunks, which are then merged pairwise.
+	//Elements are only moved, so T may be move-only and needs no default constructor
+	template<typename T, typename comp = std::less<T>, size_t arity = 2>
+	void parallel_heap_sort(std::vector<T>& data, size_t threads = std::thread::hardware_concurrency())
+	{
+		threads = std::max<size_t>(threads, 1);
+		if (threads == 1 || data.size() < parallel_threshold)
+		{
+			heap_sort<T, comp, arity>(data);
+			return;
+		}
+
+		auto chunk = (data.size() + threads - 1) / threads;
+		std::vector<size_t> bounds;
+		for (size_t bound = 0; bound < data.size(); bound += chunk)
+		{
+			bounds.push_back(bound);
+		}
+		bounds.push_back(data.size());
+
+		run_parallel(bounds.size() - 1, [&](size_t part)
+			{
+				std::vector<T> buffer(std::make_move_iterator(data.begin() + bounds[part]),
+					std::make_move_iterator(data.begin() + bounds[part + 1]));
+				heap_sort<T, comp, arity>(buffer);
+				std::move(buffer.begin(), buffer.end(), data.begin() + bounds[part]);
+			});
+
+		//heap_sort leaves the elements in reverse comp order
+		auto follows = [](const T& left, const T& right) { return comp{}(right, left); };
+		//the merge buffer is moved from the sorted chunks, which leaves data with moved-from elements that
+		//every round merges into by move assignment
+		std::vector<T> merged(std::make_move_iterator(data.begin()), std::make_move_iterator(data.end()));
+		data.swap(merged);
+
+		while (bounds.size() > 2)
+		{
+			std::vector<size_t> next_bounds;
+			for (size_t part = 0; part + 1 < bounds.size(); part += 2)
+			{
+				next_bounds.push_back(bounds[part]);
+			}
+			next_bounds.push_back(data.size());
+
+			run_parallel(next_bounds.size() - 1, [&](size_t pair)
+				{
+					auto first = bounds[2 * pair];
+					auto middle = bounds[std::min(2 * pair + 1, bounds.size() - 1)];
+					auto last = bounds[std::min(2 * pair + 2, bounds.size() - 1)];
+
+					std::merge(std::make_move_iterator(data.begin() + first), std::make_move_iterator(data.begin() + middle),
+						std::make_move_iterator(data.begin() + middle), std::make_move_iterator(data.begin() + last),
+						merged.begin() + first, follows);
+				});
+
+			data.swap(merged);
+			bounds.swap(next_bounds);
+		}
+	}
+}
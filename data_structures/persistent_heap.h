@@ -0,0 +1,521 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "heap.h"
+
+namespace heap
+{
+	//a file mapped read-write into memory; resize remaps it, so pointers into the old mapping become invalid
+	class mapped_file
+	{
+	private:
+		//closes the file also when the constructor throws after opening it
+		struct file_owner
+		{
+#ifdef _WIN32
+			HANDLE handle = INVALID_HANDLE_VALUE;
+
+			~file_owner()
+			{
+				if (handle != INVALID_HANDLE_VALUE)
+				{
+					CloseHandle(handle);
+				}
+			}
+#else
+			int handle = -1;
+
+			~file_owner()
+			{
+				if (handle >= 0)
+				{
+					::close(handle);
+				}
+			}
+#endif
+		};
+
+		std::string path;
+		unsigned char* base = nullptr;
+		size_t length = 0;
+		file_owner file;
+#ifdef _WIN32
+		HANDLE mapping = nullptr;
+#endif
+
+		[[noreturn]] void fail(const std::string& action) const
+		{
+			throw std::runtime_error{ "Cannot " + action + " " + path };
+		}
+		void map()
+		{
+			if (length == 0)
+			{
+				return;
+			}
+#ifdef _WIN32
+			mapping = CreateFileMappingA(file.handle, nullptr, PAGE_READWRITE,
+				static_cast<DWORD>(static_cast<unsigned long long>(length) >> 32), static_cast<DWORD>(length), nullptr);
+			if (mapping == nullptr)
+			{
+				fail("map");
+			}
+			base = static_cast<unsigned char*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, length));
+			if (base == nullptr)
+			{
+				CloseHandle(mapping);
+				mapping = nullptr;
+				fail("map");
+			}
+#else
+			auto mapped = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, file.handle, 0);
+			if (mapped == MAP_FAILED)
+			{
+				fail("map");
+			}
+			base = static_cast<unsigned char*>(mapped);
+#endif
+		}
+		void unmap()
+		{
+			if (base == nullptr)
+			{
+				return;
+			}
+#ifdef _WIN32
+			UnmapViewOfFile(base);
+			CloseHandle(mapping);
+			mapping = nullptr;
+#else
+			munmap(base, length);
+#endif
+			base = nullptr;
+		}
+
+	public:
+		explicit mapped_file(const std::string& path)
+			: path(path)
+		{
+#ifdef _WIN32
+			file.handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+			LARGE_INTEGER size;
+			if (file.handle == INVALID_HANDLE_VALUE || !GetFileSizeEx(file.handle, &size))
+			{
+				fail("open");
+			}
+			length = static_cast<size_t>(size.QuadPart);
+#else
+			file.handle = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+			struct stat status;
+			if (file.handle < 0 || fstat(file.handle, &status) != 0)
+			{
+				fail("open");
+			}
+			length = static_cast<size_t>(status.st_size);
+#endif
+			map();
+		}
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+		~mapped_file()
+		{
+			unmap();
+		}
+
+		unsigned char* data()
+		{
+			return base;
+		}
+		const unsigned char* data() const
+		{
+			return base;
+		}
+		size_t size() const
+		{
+			return length;
+		}
+		void resize(size_t bytes)
+		{
+			unmap();
+#ifdef _WIN32
+			LARGE_INTEGER size;
+			size.QuadPart = static_cast<LONGLONG>(bytes);
+			if (!SetFilePointerEx(file.handle, size, nullptr, FILE_BEGIN) || !SetEndOfFile(file.handle))
+			{
+				fail("resize");
+			}
+#else
+			if (ftruncate(file.handle, static_cast<off_t>(bytes)) != 0)
+			{
+				fail("resize");
+			}
+#endif
+			length = bytes;
+			map();
+		}
+		//blocks until the mapped pages are written to the file
+		void flush()
+		{
+			if (base == nullptr)
+			{
+				return;
+			}
+#ifdef _WIN32
+			if (!FlushViewOfFile(base, length) || !FlushFileBuffers(file.handle))
+			{
+				fail("flush");
+			}
+#else
+			if (msync(base, length, MS_SYNC) != 0)
+			{
+				fail("flush");
+			}
+#endif
+		}
+		//blocks until the first bytes of the file, rounded up to whole pages, are written to it
+		void flush(size_t bytes)
+		{
+			auto page = page_size();
+			bytes = std::min((bytes + page - 1) / page * page, length);
+			if (bytes == 0)
+			{
+				return;
+			}
+#ifdef _WIN32
+			if (!FlushViewOfFile(base, bytes) || !FlushFileBuffers(file.handle))
+			{
+				fail("flush");
+			}
+#else
+			if (msync(base, bytes, MS_SYNC) != 0)
+			{
+				fail("flush");
+			}
+#endif
+		}
+		static size_t page_size()
+		{
+#ifdef _WIN32
+			SYSTEM_INFO info;
+			GetSystemInfo(&info);
+			return info.dwPageSize;
+#else
+			return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+		}
+	};
+
+	//when persistent_heap writes the mapped pages to disk; without a flush the OS does it eventually,
+	//which survives a crash of the process but not of the machine
+	enum class flush_policy
+	{
+		none,
+		on_close,
+		every_change
+	};
+
+	//the first 64 bytes of a heap file. checksum covers the fields before it and is updated after every change, so a
+	//torn or foreign header is detected on open without reading the elements
+	struct persistent_heap_header
+	{
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t element_size;
+		std::uint32_t arity;
+		std::uint32_t padding;
+		std::uint64_t count;
+		std::uint64_t capacity;
+		std::uint64_t checksum;
+		//set while a change is in progress, when count and capacity may not match checksum yet
+		std::uint32_t dirty;
+		unsigned char reserved[12];
+
+		//FNV-1a over the fields before checksum
+		std::uint64_t compute_checksum() const
+		{
+			auto bytes = reinterpret_cast<const unsigned char*>(this);
+			std::uint64_t hash = 14695981039346656037ull;
+			for (size_t index = 0; index < offsetof(persistent_heap_header, checksum); index++)
+			{
+				hash = (hash ^ bytes[index]) * 1099511628211ull;
+			}
+			return hash;
+		}
+	};
+	static_assert(sizeof(persistent_heap_header) == 64, "The elements start at the second cache line of the file");
+
+	//the elements of a heap file seen as the container of interface; the count lives in the mapped header
+	template<typename T>
+	class mapped_array
+	{
+	private:
+		mapped_file file;
+		//end of the last slot handed out since the last flush_touched; the header is in front of every slot
+		size_t touched_end = 0;
+
+		void touch(size_t index)
+		{
+			touched_end = std::max(touched_end, sizeof(persistent_heap_header) + (index + 1) * sizeof(T));
+		}
+
+		persistent_heap_header& header()
+		{
+			return *reinterpret_cast<persistent_heap_header*>(file.data());
+		}
+		const persistent_heap_header& header() const
+		{
+			return *reinterpret_cast<const persistent_heap_header*>(file.data());
+		}
+		T* elements()
+		{
+			return reinterpret_cast<T*>(file.data() + sizeof(persistent_heap_header));
+		}
+		const T* elements() const
+		{
+			return reinterpret_cast<const T*>(file.data() + sizeof(persistent_heap_header));
+		}
+		void grow()
+		{
+			auto capacity = header().capacity * 2;
+			file.resize(sizeof(persistent_heap_header) + capacity * sizeof(T));
+			header().capacity = capacity;
+		}
+
+	public:
+		static constexpr char magic[8] = { 'H', 'E', 'A', 'P', 'F', 'I', 'L', 'E' };
+		static constexpr std::uint32_t version = 1;
+		static constexpr size_t initial_capacity = 1024;
+
+		//creates an empty heap file or checks the header of an existing one
+		mapped_array(const std::string& path, size_t arity)
+			: file(path)
+		{
+			if (file.size() == 0)
+			{
+				file.resize(sizeof(persistent_heap_header) + initial_capacity * sizeof(T));
+				auto& created = header();
+				std::memset(&created, 0, sizeof(created));
+				std::memcpy(created.magic, magic, sizeof(magic));
+				created.version = version;
+				created.element_size = sizeof(T);
+				created.arity = static_cast<std::uint32_t>(arity);
+				created.capacity = initial_capacity;
+				created.checksum = created.compute_checksum();
+				return;
+			}
+
+			if (file.size() < sizeof(persistent_heap_header) || std::memcmp(header().magic, magic, sizeof(magic)) != 0 ||
+				header().version != version)
+			{
+				throw std::runtime_error{ path + " is not a heap file" };
+			}
+			if (!dirty() && header().checksum != header().compute_checksum())
+			{
+				throw std::runtime_error{ "The header checksum of " + path + " does not match" };
+			}
+			if (header().element_size != sizeof(T) || header().arity != arity)
+			{
+				throw std::runtime_error{ path + " holds a heap of another element type or arity" };
+			}
+			if (header().count > header().capacity || file.size() < sizeof(persistent_heap_header) + header().capacity * sizeof(T))
+			{
+				throw std::runtime_error{ path + " is truncated" };
+			}
+		}
+
+		T& operator[](size_t index)
+		{
+			touch(index);
+			return elements()[index];
+		}
+		const T& operator[](size_t index) const
+		{
+			return elements()[index];
+		}
+		T& back()
+		{
+			touch(size() - 1);
+			return elements()[size() - 1];
+		}
+		size_t size() const
+		{
+			return static_cast<size_t>(header().count);
+		}
+		bool empty() const
+		{
+			return size() == 0;
+		}
+		void push_back(const T& value)
+		{
+			//value may refer into the mapping that grow replaces
+			T copy = value;
+			if (header().count == header().capacity)
+			{
+				grow();
+			}
+			touch(header().count);
+			elements()[header().count++] = copy;
+		}
+		void pop_back()
+		{
+			header().count--;
+		}
+
+		bool dirty() const
+		{
+			return header().dirty != 0;
+		}
+		void set_dirty(bool dirty)
+		{
+			if (!dirty)
+			{
+				header().checksum = header().compute_checksum();
+			}
+			header().dirty = dirty;
+		}
+		void flush()
+		{
+			file.flush();
+		}
+		//writes the header and the slots up to the last one handed out since the last call
+		void flush_touched()
+		{
+			file.flush(std::max(touched_end, sizeof(persistent_heap_header)));
+			touched_end = 0;
+		}
+	};
+
+	//heap of trivially copyable elements kept in a memory-mapped file: reopening the file restores the heap in O(1),
+	//without reading the elements. The sift routines are those of interface, so the order is the same as heap::heap's
+	template<typename T, typename comp = std::less<T>, size_t arity = 2>
+	class persistent_heap
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "The elements are stored as raw bytes");
+		static_assert(alignof(T) <= sizeof(persistent_heap_header), "The elements start right after the header");
+
+	private:
+		using interface = ::heap::interface<T, comp, arity, untracked, mapped_array<T>>;
+
+		mapped_array<T> data;
+		flush_policy policy;
+
+		//marks the file dirty for the duration of a change
+		template<typename F>
+		auto change(F&& operation)
+		{
+			data.set_dirty(true);
+			auto clean = [this]()
+				{
+					data.set_dirty(false);
+					if (policy == flush_policy::every_change)
+					{
+						data.flush_touched();
+					}
+				};
+
+			if constexpr (std::is_void<decltype(operation())>::value)
+			{
+				operation();
+				clean();
+			}
+			else
+			{
+				auto result = operation();
+				clean();
+				return result;
+			}
+		}
+
+	public:
+		//opens the heap file at path, creating it if it does not exist. A file an interrupted change left dirty is
+		//re-heapified in O(n); the element that change was moving may be lost or duplicated
+		explicit persistent_heap(const std::string& path, flush_policy policy = flush_policy::on_close)
+			: data(path, arity), policy(policy)
+		{
+			if (data.dirty())
+			{
+				interface::make_valid(data);
+				data.set_dirty(false);
+			}
+		}
+		persistent_heap(const persistent_heap&) = delete;
+		persistent_heap& operator=(const persistent_heap&) = delete;
+		~persistent_heap()
+		{
+			if (policy != flush_policy::none)
+			{
+				try
+				{
+					data.flush();
+				}
+				catch (const std::runtime_error&)
+				{
+					//the pages still reach the file through the OS
+				}
+			}
+		}
+
+		void insert(const T& value)
+		{
+			change([&]() { interface::insert(data, value); });
+		}
+		void replace_top(const T& value)
+		{
+			change([&]() { interface::replace_top(data, value); });
+		}
+		T remove()
+		{
+			if (data.empty())
+			{
+				throw std::invalid_argument{ "The data is empty" };
+			}
+			return change([&]() { return interface::remove(data); });
+		}
+		const T& top()
+		{
+			if (data.empty())
+			{
+				throw std::invalid_argument{ "The data is empty" };
+			}
+			return data[0];
+		}
+
+		bool empty()
+		{
+			return data.empty();
+		}
+		size_t size()
+		{
+			return data.size();
+		}
+		//writes the mapped pages to disk regardless of the policy
+		void flush()
+		{
+			data.flush();
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,290 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define HEAP_CHANNEL_COROUTINES
+#endif
+
+#include "heap.h"
+
+namespace heap
+{
+	//priority_queue shared by producer and consumer threads: dequeue blocks until an element arrives, enqueue blocks
+	//while the channel holds capacity elements. A batch is inserted under one lock and wakes the consumers once.
+	//With C++20 coroutines, co_await dequeue() suspends the consumer instead of blocking it; the producer that
+	//supplies its element resumes it after unlocking
+	template<typename K, typename V, typename comp = std::less<K>, size_t arity = 2>
+	class priority_channel
+	{
+	public:
+		using element_type = std::pair<K, V>;
+		static constexpr size_t unbounded = std::numeric_limits<size_t>::max();
+
+#ifdef HEAP_CHANNEL_COROUTINES
+		//result of co_await dequeue(): an element, or nullopt once the channel is closed and drained
+		class dequeue_awaiter
+		{
+			friend class priority_channel;
+
+			priority_channel& channel;
+			std::coroutine_handle<> continuation;
+			std::optional<element_type> result;
+			dequeue_awaiter* next = nullptr;
+
+		public:
+			explicit dequeue_awaiter(priority_channel& channel)
+				: channel(channel)
+			{
+
+			}
+
+			bool await_ready()
+			{
+				return false;
+			}
+			bool await_suspend(std::coroutine_handle<> handle)
+			{
+				std::unique_lock<std::mutex> lock(channel.mutex);
+				if (channel.count > 0)
+				{
+					result = channel.take();
+					lock.unlock();
+					channel.writable.notify_one();
+					return false;
+				}
+				if (channel.closed)
+				{
+					return false;
+				}
+
+				continuation = handle;
+				(channel.waiting_last == nullptr ? channel.waiting_first : channel.waiting_last->next) = this;
+				channel.waiting_last = this;
+				return true;
+			}
+			std::optional<element_type> await_resume()
+			{
+				return std::move(result);
+			}
+		};
+#endif
+
+	private:
+		std::mutex mutex;
+		std::condition_variable readable, writable;
+		priority_queue<K, V, comp, arity> queue;
+		size_t count = 0;
+		size_t limit;
+		bool closed = false;
+
+#ifdef HEAP_CHANNEL_COROUTINES
+		//suspended consumers in arrival order; there are none while the channel holds elements
+		dequeue_awaiter* waiting_first = nullptr;
+		dequeue_awaiter* waiting_last = nullptr;
+		std::vector<dequeue_awaiter*> ready;
+#endif
+
+		element_type take()
+		{
+			count--;
+			return queue.dequeue();
+		}
+		void check_open()
+		{
+			if (closed)
+			{
+				throw std::runtime_error{ "The channel is closed" };
+			}
+		}
+
+		//hands the top elements to suspended consumers; called under the lock, they are resumed by release
+		void hand_off()
+		{
+#ifdef HEAP_CHANNEL_COROUTINES
+			while (waiting_first != nullptr && (count > 0 || closed))
+			{
+				auto waiter = waiting_first;
+				waiting_first = waiter->next;
+				if (waiting_first == nullptr)
+				{
+					waiting_last = nullptr;
+				}
+				if (count > 0)
+				{
+					waiter->result = take();
+				}
+				ready.push_back(waiter);
+			}
+#endif
+		}
+		//unlocks, wakes the blocked consumers once for the available elements and resumes the handed-off ones
+		void release(std::unique_lock<std::mutex>& lock)
+		{
+			auto available = count;
+#ifdef HEAP_CHANNEL_COROUTINES
+			std::vector<dequeue_awaiter*> resumed;
+			resumed.swap(ready);
+#endif
+			lock.unlock();
+
+			if (available > 1)
+			{
+				readable.notify_all();
+			}
+			else if (available == 1)
+			{
+				readable.notify_one();
+			}
+
+#ifdef HEAP_CHANNEL_COROUTINES
+			if (!resumed.empty())
+			{
+				//handing elements off made room for blocked producers
+				writable.notify_all();
+			}
+			for (auto waiter : resumed)
+			{
+				waiter->continuation.resume();
+			}
+#endif
+		}
+
+	public:
+		explicit priority_channel(size_t capacity = unbounded)
+			: limit(capacity)
+		{
+			if (capacity == 0)
+			{
+				throw std::invalid_argument{ "The capacity has to be positive" };
+			}
+		}
+		priority_channel(const priority_channel&) = delete;
+		priority_channel& operator=(const priority_channel&) = delete;
+
+		//blocks while the channel is full; throws if it is closed
+		void enqueue(K key, V value)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			writable.wait(lock, [this]() { return closed || count < limit; });
+			check_open();
+
+			queue.enqueue(std::move(key), std::move(value));
+			count++;
+			hand_off();
+			release(lock);
+		}
+		//inserts a range of element_type, as much of it at a time as the capacity admits
+		template<typename Iterator>
+		void enqueue(Iterator first, Iterator last)
+		{
+			while (first != last)
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				writable.wait(lock, [this]() { return closed || count < limit; });
+				check_open();
+
+				for (; first != last && count < limit; ++first)
+				{
+					queue.enqueue(first->first, first->second);
+					count++;
+				}
+				hand_off();
+				release(lock);
+			}
+		}
+		bool try_enqueue(K key, V value)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			check_open();
+			if (count == limit)
+			{
+				return false;
+			}
+
+			queue.enqueue(std::move(key), std::move(value));
+			count++;
+			hand_off();
+			release(lock);
+			return true;
+		}
+
+		//blocks until an element arrives; returns false once the channel is closed and drained
+		bool dequeue(element_type& value)
+		{
+			return dequeue_n(&value, 1) == 1;
+		}
+		//blocks until an element arrives, then writes up to wanted elements from the top; returns how many were written
+		template<typename Iterator>
+		size_t dequeue_n(Iterator out, size_t wanted)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			readable.wait(lock, [this]() { return closed || count > 0; });
+
+			size_t written = 0;
+			for (; written < wanted && count > 0; written++)
+			{
+				*out++ = take();
+			}
+			lock.unlock();
+
+			if (written > 1)
+			{
+				writable.notify_all();
+			}
+			else if (written == 1)
+			{
+				writable.notify_one();
+			}
+			return written;
+		}
+		bool try_dequeue(element_type& value)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			if (count == 0)
+			{
+				return false;
+			}
+
+			value = take();
+			lock.unlock();
+			writable.notify_one();
+			return true;
+		}
+#ifdef HEAP_CHANNEL_COROUTINES
+		dequeue_awaiter dequeue()
+		{
+			return dequeue_awaiter{ *this };
+		}
+#endif
+
+		//rejects further enqueues; consumers drain what is left and are then told the channel is closed
+		void close()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			closed = true;
+			hand_off();
+			readable.notify_all();
+			writable.notify_all();
+			release(lock);
+		}
+
+		size_t size()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return count;
+		}
+		size_t capacity() const
+		{
+			return limit;
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace heap
+{
+	//monotone priority queue for unsigned integer keys with the enqueue/dequeue/empty interface of priority_queue:
+	//the smallest key is dequeued first and a key may not be enqueued below the last dequeued one, as in Dijkstra's
+	//algorithm or event simulation. An element sits in the bucket of the highest bit in which its key differs from
+	//the last dequeued key and is only moved to a lower bucket, so every operation is O(log C) amortized for keys up to C
+	template<typename K, typename V>
+	class radix_heap
+	{
+	private:
+		static_assert(std::is_integral<K>::value && std::is_unsigned<K>::value, "Keys have to be unsigned integers");
+
+		using element_type = std::pair<K, V>;
+		static constexpr size_t key_bits = std::numeric_limits<K>::digits;
+
+		//bucket 0 holds the keys equal to last, bucket b the keys whose highest bit differing from last is b - 1
+		std::array<std::vector<element_type>, key_bits + 1> buckets;
+		K last = 0;
+		size_t count = 0;
+
+		static size_t bit_width(unsigned long long value)
+		{
+			if (value == 0)
+			{
+				return 0;
+			}
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+			unsigned long index;
+			_BitScanReverse64(&index, value);
+			return index + 1;
+#elif defined(_MSC_VER)
+			unsigned long index;
+			if (_BitScanReverse(&index, static_cast<unsigned long>(value >> 32)))
+			{
+				return index + 33;
+			}
+			_BitScanReverse(&index, static_cast<unsigned long>(value));
+			return index + 1;
+#else
+			return 64 - static_cast<size_t>(__builtin_clzll(value));
+#endif
+		}
+		size_t bucket(K key) const
+		{
+			return bit_width(static_cast<unsigned long long>(key ^ last));
+		}
+
+		//moves last up to the smallest key and spreads the first non-empty bucket over the lower ones.
+		//Every element of bucket b shares the bits above b - 1 with the new last, so it lands below b
+		void refill()
+		{
+			size_t source = 1;
+			while (buckets[source].empty())
+			{
+				source++;
+			}
+
+			auto& moved = buckets[source];
+			auto smallest = moved[0].first;
+			for (auto& element : moved)
+			{
+				if (element.first < smallest)
+				{
+					smallest = element.first;
+				}
+			}
+
+			last = smallest;
+			for (auto& element : moved)
+			{
+				buckets[bucket(element.first)].push_back(std::move(element));
+			}
+			moved.clear();
+		}
+
+	public:
+		radix_heap() = default;
+
+		void enqueue(K key, V value)
+		{
+			if (key < last)
+			{
+				throw std::invalid_argument{ "The key is below the last dequeued one" };
+			}
+
+			buckets[bucket(key)].emplace_back(key, std::move(value));
+			count++;
+		}
+		element_type dequeue()
+		{
+			if (count == 0)
+			{
+				throw std::invalid_argument{ "The data is empty" };
+			}
+
+			if (buckets[0].empty())
+			{
+				refill();
+			}
+
+			auto result = std::move(buckets[0].back());
+			buckets[0].pop_back();
+			count--;
+			return result;
+		}
+		bool empty()
+		{
+			return count == 0;
+		}
+		size_t size()
+		{
+			return count;
+		}
+		//the smallest key enqueue still accepts
+		K last_key() const
+		{
+			return last;
+		}
+	};
+}
\ No newline at end of file
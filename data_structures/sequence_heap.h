@@ -0,0 +1,277 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "heap.h"
+
+namespace heap
+{
+	//Sanders' sequence heap with the insert/remove/empty interface of heap::heap. New elements go to a small
+	//insertion heap; when it is full it is sorted into a sequence of group 0. Group i holds up to group_width sorted
+	//sequences and a buffer with their smallest elements; a full group is merged into one sequence of group i + 1.
+	//remove takes the smaller of the insertion heap top and the front of the delete buffer, which is refilled from the
+	//group buffers. Every structure that is touched per element is small or read sequentially, so large queues mostly
+	//stream through memory instead of missing the cache on every level of a binary heap
+	template<typename T, typename comp = std::less<T>>
+	class sequence_heap
+	{
+	private:
+		using insertion_interface = ::heap::interface<T, comp>;
+		static constexpr comp precede = comp{};
+
+		//capacity of the insertion heap and of every group buffer
+		static constexpr size_t buffer_size = 512;
+		static constexpr size_t delete_buffer_size = 256;
+		//sequences per group, i.e. the fan-in of the merges
+		static constexpr size_t group_width = 64;
+
+		//a sorted sequence consumed from the front
+		struct run
+		{
+			std::vector<T> items;
+			size_t head = 0;
+
+			bool exhausted() const
+			{
+				return head == items.size();
+			}
+			T& front()
+			{
+				return items[head];
+			}
+			size_t remaining() const
+			{
+				return items.size() - head;
+			}
+			void reset()
+			{
+				items.clear();
+				head = 0;
+			}
+		};
+		struct group
+		{
+			std::vector<run> runs;
+			run buffer;
+		};
+		struct source_comp
+		{
+			constexpr bool operator()(const std::pair<T, size_t>& left, const std::pair<T, size_t>& right) const
+			{
+				return precede(left.first, right.first);
+			}
+		};
+		using tournament = ::heap::interface<std::pair<T, size_t>, source_comp>;
+
+		std::vector<T> insertion;
+		run deleted;
+		std::vector<group> groups;
+		size_t count = 0;
+
+		//k-way merge of the fronts of sources into out until limit elements were written; the unwritten heads go back
+		static void merge(std::vector<run*>& sources, std::vector<T>& out, size_t limit)
+		{
+			std::vector<std::pair<T, size_t>> heads;
+			heads.reserve(sources.size());
+			for (size_t index = 0; index < sources.size(); index++)
+			{
+				if (!sources[index]->exhausted())
+				{
+					heads.emplace_back(std::move(sources[index]->front()), index);
+					sources[index]->head++;
+				}
+			}
+			tournament::make_valid(heads);
+
+			for (size_t written = 0; written < limit && !heads.empty(); written++)
+			{
+				out.push_back(std::move(heads[0].first));
+
+				auto& source = *sources[heads[0].second];
+				if (!source.exhausted())
+				{
+					heads[0].first = std::move(source.front());
+					source.head++;
+					tournament::bubble_down(heads, heads.size());
+				}
+				else
+				{
+					tournament::remove(heads);
+				}
+			}
+
+			for (auto& head : heads)
+			{
+				auto& source = *sources[head.second];
+				source.head--;
+				source.front() = std::move(head.first);
+			}
+		}
+
+		void refill_buffer(group& target)
+		{
+			target.buffer.reset();
+
+			std::vector<run*> sources;
+			for (auto& sequence : target.runs)
+			{
+				sources.push_back(&sequence);
+			}
+			merge(sources, target.buffer.items, buffer_size);
+
+			target.runs.erase(std::remove_if(target.runs.begin(), target.runs.end(),
+				[](const run& sequence) { return sequence.exhausted(); }), target.runs.end());
+		}
+		//every element of the groups follows the delete buffer, and every group buffer precedes its sequences,
+		//so merging the group buffers yields the smallest elements of all groups
+		void refill_delete_buffer()
+		{
+			deleted.reset();
+			for (auto& target : groups)
+			{
+				if (target.buffer.exhausted() && !target.runs.empty())
+				{
+					refill_buffer(target);
+				}
+			}
+
+			while (deleted.items.size() < delete_buffer_size)
+			{
+				group* best = nullptr;
+				for (auto& target : groups)
+				{
+					if (!target.buffer.exhausted() && (best == nullptr || precede(target.buffer.front(), best->buffer.front())))
+					{
+						best = &target;
+					}
+				}
+				if (best == nullptr)
+				{
+					return;
+				}
+
+				deleted.items.push_back(std::move(best->buffer.front()));
+				best->buffer.head++;
+				if (best->buffer.exhausted() && !best->runs.empty())
+				{
+					refill_buffer(*best);
+				}
+			}
+		}
+
+		//adds a sorted sequence to groups[level], first moving a full group up a level.
+		//The group buffer is folded into the sequence, since the sequence may precede it
+		void insert_run(size_t level, std::vector<T> sequence)
+		{
+			if (groups.size() == level)
+			{
+				groups.emplace_back();
+			}
+
+			if (groups[level].runs.size() == group_width)
+			{
+				std::vector<run*> sources;
+				size_t total = groups[level].buffer.remaining();
+				for (auto& full : groups[level].runs)
+				{
+					sources.push_back(&full);
+					total += full.remaining();
+				}
+				sources.push_back(&groups[level].buffer);
+
+				std::vector<T> merged;
+				merged.reserve(total);
+				merge(sources, merged, std::numeric_limits<size_t>::max());
+				groups[level].runs.clear();
+				groups[level].buffer.reset();
+				insert_run(level + 1, std::move(merged));
+			}
+
+			auto& target = groups[level];
+			if (!target.buffer.exhausted())
+			{
+				std::vector<T> folded;
+				folded.reserve(target.buffer.remaining() + sequence.size());
+				std::merge(std::make_move_iterator(target.buffer.items.begin() + target.buffer.head),
+					std::make_move_iterator(target.buffer.items.end()),
+					std::make_move_iterator(sequence.begin()), std::make_move_iterator(sequence.end()),
+					std::back_inserter(folded), precede);
+				sequence.swap(folded);
+				target.buffer.reset();
+			}
+			target.runs.push_back({ std::move(sequence), 0 });
+		}
+		//sorts the insertion heap into a sequence; its smallest elements replace those of the delete buffer they precede
+		void flush_insertion()
+		{
+			std::sort(insertion.begin(), insertion.end(), precede);
+
+			auto kept = deleted.remaining();
+			std::vector<T> merged;
+			merged.reserve(kept + insertion.size());
+			std::merge(std::make_move_iterator(deleted.items.begin() + deleted.head), std::make_move_iterator(deleted.items.end()),
+				std::make_move_iterator(insertion.begin()), std::make_move_iterator(insertion.end()),
+				std::back_inserter(merged), precede);
+			insertion.clear();
+
+			deleted.reset();
+			deleted.items.assign(std::make_move_iterator(merged.begin()), std::make_move_iterator(merged.begin() + kept));
+			insert_run(0, std::vector<T>(std::make_move_iterator(merged.begin() + kept), std::make_move_iterator(merged.end())));
+		}
+
+	public:
+		sequence_heap()
+		{
+			insertion.reserve(buffer_size);
+		}
+
+		void insert(const T& value)
+		{
+			insert(T(value));
+		}
+		void insert(T&& value)
+		{
+			if (insertion.size() == buffer_size)
+			{
+				flush_insertion();
+			}
+
+			insertion_interface::insert(insertion, std::move(value));
+			count++;
+		}
+		T remove()
+		{
+			if (count == 0)
+			{
+				throw std::invalid_argument{ "The data is empty" };
+			}
+
+			if (deleted.exhausted())
+			{
+				refill_delete_buffer();
+			}
+			count--;
+
+			if (!insertion.empty() && (deleted.exhausted() || precede(insertion[0], deleted.front())))
+			{
+				return insertion_interface::remove(insertion);
+			}
+			return std::move(deleted.items[deleted.head++]);
+		}
+
+		bool empty()
+		{
+			return count == 0;
+		}
+		size_t size()
+		{
+			return count;
+		}
+	};
+}
\ No newline at end of file
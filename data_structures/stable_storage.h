@@ -0,0 +1,199 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#endif
+
+namespace heap
+{
+	//element store whose addresses stay valid until the element is erased, the replacement for the std::list that
+	//heap_wrapper used to reference. Elements live in chunks that at least double the capacity, so n insertions
+	//allocate O(log n) times, and an erased slot is reused by the next emplace before a new chunk is taken.
+	//The chunks come from Allocator, e.g. from a std::pmr::memory_resource with pmr::stable_storage
+	template<typename T, typename Allocator = std::allocator<T>>
+	class stable_storage
+	{
+	private:
+		static constexpr size_t min_chunk_size = 64;
+
+		//the value is constructed only while the node is occupied; free nodes are chained through next_free
+		struct node
+		{
+			alignas(T) unsigned char storage[sizeof(T)];
+			node* next_free;
+			bool occupied;
+
+			T& value()
+			{
+				return *std::launder(reinterpret_cast<T*>(storage));
+			}
+		};
+		struct chunk
+		{
+			node* nodes;
+			size_t capacity;
+		};
+		using node_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<node>;
+		using node_traits = std::allocator_traits<node_allocator>;
+		using chunk_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<chunk>;
+
+		node_allocator allocator;
+		std::vector<chunk, chunk_allocator> chunks;
+		//nodes of the last chunk that were ever handed out; all nodes of the earlier chunks were
+		size_t used = 0;
+		size_t reserved = 0;
+		size_t count = 0;
+		node* free_nodes = nullptr;
+
+		void add_chunk(size_t capacity)
+		{
+			chunks.push_back({ node_traits::allocate(allocator, capacity), capacity });
+			used = 0;
+			reserved += capacity;
+		}
+		static node* to_node(T& value)
+		{
+			//storage is the first member of node
+			return reinterpret_cast<node*>(&value);
+		}
+		template<typename F>
+		void visit_nodes(F&& function)
+		{
+			for (size_t index = 0; index < chunks.size(); index++)
+			{
+				auto end = index + 1 == chunks.size() ? used : chunks[index].capacity;
+				for (size_t offset = 0; offset < end; offset++)
+				{
+					function(chunks[index].nodes[offset]);
+				}
+			}
+		}
+
+	public:
+		explicit stable_storage(const Allocator& allocator = Allocator())
+			: allocator(allocator), chunks(chunk_allocator(allocator))
+		{
+
+		}
+		template<typename Iterator>
+		stable_storage(Iterator first, Iterator last, const Allocator& allocator = Allocator())
+			: stable_storage(allocator)
+		{
+			for (; first != last; ++first)
+			{
+				emplace(*first);
+			}
+		}
+		stable_storage(std::initializer_list<T> items, const Allocator& allocator = Allocator())
+			: stable_storage(items.begin(), items.end(), allocator)
+		{
+
+		}
+		//the chunks change owners, so the addresses of the elements stay valid
+		stable_storage(stable_storage&& other) noexcept
+			: allocator(std::move(other.allocator)), chunks(std::move(other.chunks)), used(other.used),
+			reserved(other.reserved), count(other.count), free_nodes(other.free_nodes)
+		{
+			other.chunks.clear();
+			other.used = other.reserved = other.count = 0;
+			other.free_nodes = nullptr;
+		}
+		stable_storage(const stable_storage&) = delete;
+		stable_storage& operator=(const stable_storage&) = delete;
+		stable_storage& operator=(stable_storage&&) = delete;
+		~stable_storage()
+		{
+			visit_nodes([](node& target)
+				{
+					if (target.occupied)
+					{
+						target.value().~T();
+					}
+				});
+			for (auto& owned : chunks)
+			{
+				node_traits::deallocate(allocator, owned.nodes, owned.capacity);
+			}
+		}
+
+		//the returned reference stays valid until the element is erased
+		template<typename... Args>
+		T& emplace(Args&&... args)
+		{
+			auto reused = free_nodes != nullptr;
+			if (!reused && (chunks.empty() || used == chunks.back().capacity))
+			{
+				add_chunk(std::max(min_chunk_size, reserved));
+			}
+
+			//nothing is committed before the constructor returns
+			auto target = reused ? free_nodes : chunks.back().nodes + used;
+			::new (static_cast<void*>(target->storage)) T(std::forward<Args>(args)...);
+			if (reused)
+			{
+				free_nodes = target->next_free;
+			}
+			else
+			{
+				used++;
+			}
+
+			target->occupied = true;
+			count++;
+			return target->value();
+		}
+		//value has to be an element of this storage
+		void erase(T& value)
+		{
+			auto target = to_node(value);
+			value.~T();
+			target->occupied = false;
+			target->next_free = free_nodes;
+			free_nodes = target;
+			count--;
+		}
+
+		//calls function with every element, in no particular order
+		template<typename F>
+		void for_each(F&& function)
+		{
+			visit_nodes([&function](node& target)
+				{
+					if (target.occupied)
+					{
+						function(target.value());
+					}
+				});
+		}
+
+		size_t size() const
+		{
+			return count;
+		}
+		bool empty() const
+		{
+			return count == 0;
+		}
+		//slots allocated so far, occupied or free
+		size_t capacity() const
+		{
+			return reserved;
+		}
+	};
+
+#ifdef __cpp_lib_memory_resource
+	namespace pmr
+	{
+		template<typename T>
+		using stable_storage = ::heap::stable_storage<T, std::pmr::polymorphic_allocator<T>>;
+	}
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,9 @@
+#include "stdafx.h"
+
+extern bool run_tests();
+
+//entry point of the CMake test target; the Visual Studio project runs the tests from main.cpp
+int main()
+{
+	return run_tests() ? 0 : 1;
+}
\ No newline at end of file
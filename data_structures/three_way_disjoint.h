@@ -7,7 +7,7 @@ using namespace std;
 
 bool three_way_disjoint(vector<int> a, vector<int> b, vector<int> c)
 {
-	int ptr1 = 0, ptr2 = 0, ptr3 = 0;
+	size_t ptr1 = 0, ptr2 = 0, ptr3 = 0;
 
 	sort(a.begin(), a.end());
 	sort(b.begin(), b.end());
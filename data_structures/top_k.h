@@ -0,0 +1,235 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HEAP_TOP_K_SSE2
+#endif
+
+#include "heap.h"
+
+namespace heap
+{
+	//tells whether any of the block_width values starting at values follows threshold,
+	//i.e. could enter a top_k whose smallest kept element is threshold
+	template<typename T, typename comp>
+	struct top_k_filter
+	{
+		static constexpr size_t block_width = 16;
+		static constexpr comp precede = comp{};
+
+		static bool any_follows(const T* values, const T& threshold)
+		{
+			//no early exit so that the loop stays branch-free
+			bool found = false;
+			for (size_t index = 0; index < block_width; index++)
+			{
+				found |= precede(threshold, values[index]);
+			}
+			return found;
+		}
+	};
+
+#ifdef HEAP_TOP_K_SSE2
+	template<bool greater_first>
+	struct top_k_filter_int
+	{
+		static constexpr size_t block_width = 16;
+
+		static bool any_follows(const int* values, const int& threshold)
+		{
+			auto limit = _mm_set1_epi32(threshold);
+			auto found = _mm_setzero_si128();
+			for (size_t index = 0; index < block_width; index += 4)
+			{
+				auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + index));
+				found = _mm_or_si128(found, greater_first ? _mm_cmplt_epi32(block, limit) : _mm_cmpgt_epi32(block, limit));
+			}
+			return _mm_movemask_epi8(found) != 0;
+		}
+	};
+
+	template<bool greater_first>
+	struct top_k_filter_float
+	{
+		static constexpr size_t block_width = 16;
+
+		static bool any_follows(const float* values, const float& threshold)
+		{
+			auto limit = _mm_set1_ps(threshold);
+			auto found = _mm_setzero_ps();
+			for (size_t index = 0; index < block_width; index += 4)
+			{
+				auto block = _mm_loadu_ps(values + index);
+				found = _mm_or_ps(found, greater_first ? _mm_cmplt_ps(block, limit) : _mm_cmpgt_ps(block, limit));
+			}
+			return _mm_movemask_ps(found) != 0;
+		}
+	};
+
+	template<>
+	struct top_k_filter<int, std::less<int>> : top_k_filter_int<false>
+	{
+
+	};
+	template<>
+	struct top_k_filter<int, std::greater<int>> : top_k_filter_int<true>
+	{
+
+	};
+	template<>
+	struct top_k_filter<float, std::less<float>> : top_k_filter_float<false>
+	{
+
+	};
+	template<>
+	struct top_k_filter<float, std::greater<float>> : top_k_filter_float<true>
+	{
+
+	};
+#endif
+
+	//keeps the k elements of a stream that come last in comp order (the k largest for std::less).
+	//The kept elements form a heap whose top is the admission threshold, so an element that cannot
+	//enter costs a single comparison; contiguous batches are screened a whole block at a time
+	template<typename T, typename comp = std::less<T>, size_t arity = 2>
+	class top_k
+	{
+	private:
+		using interface = ::heap::interface<T, comp, arity>;
+		using filter = top_k_filter<T, comp>;
+		static constexpr comp precede = comp{};
+
+		std::vector<T> data;
+		size_t k;
+
+		bool full() const
+		{
+			return data.size() == k;
+		}
+		template<typename U>
+		void offer(U&& value)
+		{
+			if (!full())
+			{
+				interface::insert(data, std::forward<U>(value));
+			}
+			else if (k > 0 && precede(data[0], value))
+			{
+				interface::replace_top(data, std::forward<U>(value));
+			}
+		}
+		void push_contiguous(const T* first, const T* last)
+		{
+			while (first != last && !full())
+			{
+				offer(*first++);
+			}
+
+			if (k == 0)
+			{
+				return;
+			}
+
+			for (; last - first >= static_cast<std::ptrdiff_t>(filter::block_width); first += filter::block_width)
+			{
+				//the threshold only rises, so a block rejected against the current one stays rejected
+				if (filter::any_follows(first, data[0]))
+				{
+					for (size_t index = 0; index < filter::block_width; index++)
+					{
+						offer(first[index]);
+					}
+				}
+			}
+
+			while (first != last)
+			{
+				offer(*first++);
+			}
+		}
+
+	public:
+		explicit top_k(size_t k)
+			: k(k)
+		{
+			data.reserve(k);
+		}
+
+		void push(const T& value)
+		{
+			offer(value);
+		}
+		void push(T&& value)
+		{
+			offer(std::move(value));
+		}
+		template<typename Iterator>
+		void push(Iterator first, Iterator last)
+		{
+			for (; first != last; ++first)
+			{
+				offer(*first);
+			}
+		}
+		void push(const T* first, const T* last)
+		{
+			push_contiguous(first, last);
+		}
+		void push(T* first, T* last)
+		{
+			push_contiguous(first, last);
+		}
+		void push(const std::vector<T>& batch)
+		{
+			push_contiguous(batch.data(), batch.data() + batch.size());
+		}
+
+		//combines the results of two partial streams, e.g. those of two threads
+		void merge(const top_k& other)
+		{
+			if (other.k != k)
+			{
+				throw std::invalid_argument{ "The top_k states keep different numbers of elements" };
+			}
+			if (&other == this)
+			{
+				return;
+			}
+
+			push(other.data);
+		}
+
+		size_t size() const
+		{
+			return data.size();
+		}
+		//the element a new one has to follow to be kept, valid once k elements were seen
+		const T& threshold() const
+		{
+			if (!full() || k == 0)
+			{
+				throw std::logic_error{ "Fewer than k elements were seen" };
+			}
+
+			return data[0];
+		}
+
+		//returns the kept elements, the last in comp order first, and leaves the state empty
+		std::vector<T> finish()
+		{
+			interface::sort(data);
+
+			std::vector<T> result;
+			result.swap(data);
+			data.reserve(k);
+			return result;
+		}
+	};
+}